@@ -0,0 +1,60 @@
+// Memory against latency over the number of candidate buckets. Every table is
+// filled past its load threshold until the first insertion fails, so the load
+// column is the load factor the arity reaches; more candidates pack the table
+// tighter but make misses and kicks probe more buckets.
+// usage: arity [num_keys]
+#include "d_ary_cuckoofilter.h"
+#include "timing.h"
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace d_ary_cuckoofilter;
+
+template <size_t bits_per_item, size_t num_candidate_buckets>
+void Run(size_t num_keys) {
+    DaryCuckooFilter<uint64_t, bits_per_item, num_candidate_buckets, SingleTable> filter(num_keys);
+    std::vector<uint64_t> keys = RandomHashes(filter.SizeInBuckets(), 1);
+    std::vector<uint64_t> others = RandomHashes(filter.SizeInBuckets(), 2);
+
+    Timer add;
+    size_t num_inserted = 0;
+    for (; num_inserted < keys.size(); num_inserted++) {
+        if (filter.AddHash(keys[num_inserted]) != Ok) break;
+    }
+    double add_ns = add.NsPerOp(num_inserted);
+
+    size_t found = 0;
+    Timer hit;
+    for (size_t k = 0; k < num_inserted; k++) found += filter.ContainHash(keys[k]) == Ok;
+    double hit_ns = hit.NsPerOp(num_inserted);
+
+    Timer miss;
+    for (size_t k = 0; k < num_inserted; k++) found += filter.ContainHash(others[k]) == Ok;
+    double miss_ns = miss.NsPerOp(num_inserted);
+
+    std::cout << bits_per_item << "\t" << num_candidate_buckets << "\t"
+              << SingleTable<bits_per_item>::LoadThreshold(num_candidate_buckets) << "\t"
+              << filter.LoadFactor() << "\t" << filter.BitsPerItem() << "\t"
+              << add_ns << "\t" << hit_ns << "\t" << miss_ns << "\n";
+}
+
+template <size_t bits_per_item>
+void RunAll(size_t num_keys) {
+    Run<bits_per_item, 2>(num_keys);
+    Run<bits_per_item, 3>(num_keys);
+    Run<bits_per_item, 4>(num_keys);
+    Run<bits_per_item, 5>(num_keys);
+    Run<bits_per_item, 6>(num_keys);
+    Run<bits_per_item, 7>(num_keys);
+    Run<bits_per_item, 8>(num_keys);
+}
+
+int main(int argc, char** argv) {
+    size_t num_keys = argc > 1 ? strtoull(argv[1], NULL, 10) : (1 << 22);
+
+    std::cout << "bits\td\tthreshold\tload\tbits/item\tadd ns\thit ns\tmiss ns\n";
+    RunAll<8>(num_keys);
+    RunAll<16>(num_keys);
+    return 0;
+}
@@ -0,0 +1,89 @@
+// Lookup cost of every tag size and arity. Tag size and arity are template
+// parameters, and ReadTag/WriteTag and the candidate loops are selected and
+// unrolled at compile time, so no configuration pays for a run-time dispatch;
+// Resolved() fails the build otherwise. Probe() is kept out of line so its
+// code can be inspected per configuration:
+//   objdump -d --no-show-raw-insn config_dispatch | c++filt | grep -A80 'Probe<'
+// usage: config_dispatch [num_keys]
+#include "d_ary_cuckoofilter.h"
+#include "timing.h"
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace d_ary_cuckoofilter;
+
+// True if a configuration leaves nothing to decide at run time: a tag is read
+// and written as one word of exactly its width, and the candidate loops visit
+// every candidate once with an index known at compile time, which the
+// static_assert only accepts if it is a constant.
+template <size_t bits_per_item, size_t num_candidate_buckets>
+constexpr bool Resolved() {
+    size_t visited = 0;
+    unrolled<num_candidate_buckets>([&](auto j) {
+        static_assert(decltype(j)::value < num_candidate_buckets, "candidate index out of range");
+        visited |= (size_t) 1 << j;
+    });
+    const bool any = unrolledany<num_candidate_buckets>([&](auto j) {
+        return j == num_candidate_buckets - 1;
+    });
+    return sizeof(typename TagWord<bits_per_item>::type) * 8 == bits_per_item &&
+           visited == ((size_t) 1 << num_candidate_buckets) - 1 && any;
+}
+
+template <size_t bits_per_item, size_t num_candidate_buckets>
+__attribute__((noinline)) Status
+Probe(const DaryCuckooFilter<uint64_t, bits_per_item, num_candidate_buckets, SingleTable>& filter,
+      uint64_t hv) {
+    return filter.ContainHash(hv);
+}
+
+template <size_t bits_per_item, size_t num_candidate_buckets>
+void Run(size_t num_keys) {
+    static_assert(Resolved<bits_per_item, num_candidate_buckets>(),
+                  "configuration not resolved at compile time");
+    DaryCuckooFilter<uint64_t, bits_per_item, num_candidate_buckets, SingleTable> filter(num_keys);
+    std::vector<uint64_t> keys = RandomHashes(num_keys, 1);
+    std::vector<uint64_t> others = RandomHashes(num_keys, 2);
+
+    Timer add;
+    size_t num_inserted = 0;
+    for (; num_inserted < num_keys; num_inserted++) {
+        if (filter.AddHash(keys[num_inserted]) != Ok) break;
+    }
+    double add_ns = add.NsPerOp(num_inserted);
+
+    size_t found = 0;
+    Timer hit;
+    for (size_t k = 0; k < num_inserted; k++) found += Probe(filter, keys[k]) == Ok;
+    double hit_ns = hit.NsPerOp(num_inserted);
+
+    Timer miss;
+    for (size_t k = 0; k < num_inserted; k++) found += Probe(filter, others[k]) == Ok;
+    double miss_ns = miss.NsPerOp(num_inserted);
+
+    std::cout << bits_per_item << "\t" << num_candidate_buckets << "\t"
+              << filter.LoadFactor() << "\t" << add_ns << "\t"
+              << hit_ns << "\t" << miss_ns << "\t" << found << "\n";
+}
+
+template <size_t bits_per_item>
+void RunAll(size_t num_keys) {
+    Run<bits_per_item, 2>(num_keys);
+    Run<bits_per_item, 3>(num_keys);
+    Run<bits_per_item, 4>(num_keys);
+    Run<bits_per_item, 5>(num_keys);
+    Run<bits_per_item, 6>(num_keys);
+    Run<bits_per_item, 7>(num_keys);
+    Run<bits_per_item, 8>(num_keys);
+}
+
+int main(int argc, char** argv) {
+    size_t num_keys = argc > 1 ? strtoull(argv[1], NULL, 10) : (1 << 22);
+
+    std::cout << "bits\td\tload\tadd ns\thit ns\tmiss ns\tfound\n";
+    RunAll<8>(num_keys);
+    RunAll<16>(num_keys);
+    RunAll<32>(num_keys);
+    return 0;
+}
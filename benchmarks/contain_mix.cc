@@ -0,0 +1,49 @@
+// Lookup cost by the share of lookups that hit. Contain probes the index of an
+// item before computing any other candidate, so hits get cheaper than misses
+// and the cost falls as the hit ratio grows.
+// usage: contain_mix [num_keys]
+#include "d_ary_cuckoofilter.h"
+#include "timing.h"
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace d_ary_cuckoofilter;
+
+template <size_t bits_per_item, size_t num_candidate_buckets>
+void Run(size_t num_keys) {
+    DaryCuckooFilter<uint64_t, bits_per_item, num_candidate_buckets, SingleTable> filter(num_keys);
+    std::vector<uint64_t> keys = RandomHashes(num_keys, 1);
+    std::vector<uint64_t> others = RandomHashes(num_keys, 2);
+
+    size_t num_inserted = 0;
+    for (; num_inserted < num_keys; num_inserted++) {
+        if (filter.AddHash(keys[num_inserted]) != Ok) break;
+    }
+
+    for (size_t percent = 0; percent <= 100; percent += 25) {
+        // the k-th lookup hits when it falls below the hit ratio, spread evenly
+        std::vector<uint64_t> queries(num_inserted);
+        for (size_t k = 0; k < num_inserted; k++) {
+            queries[k] = (k * 100 / num_inserted + k) % 100 < percent ? keys[k] : others[k];
+        }
+        size_t found = 0;
+        Timer timer;
+        for (size_t k = 0; k < num_inserted; k++) found += filter.ContainHash(queries[k]) == Ok;
+        double ns = timer.NsPerOp(num_inserted);
+
+        std::cout << bits_per_item << "\t" << num_candidate_buckets << "\t"
+                  << percent << "\t" << ns << "\t" << found << "\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t num_keys = argc > 1 ? strtoull(argv[1], NULL, 10) : (1 << 22);
+
+    std::cout << "bits\td\thit %\tns\tfound\n";
+    Run<16, 2>(num_keys);
+    Run<16, 3>(num_keys);
+    Run<16, 4>(num_keys);
+    Run<16, 5>(num_keys);
+    return 0;
+}
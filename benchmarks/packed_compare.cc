@@ -0,0 +1,54 @@
+// Memory and speed of PackedTable, two 32-bit words per slot, against
+// CompactPackedTable, tag and mark packed into bits_per_item + markbits(d) bits.
+// usage: packed_compare [num_keys]
+#include "d_ary_cuckoofilter.h"
+#include "timing.h"
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace d_ary_cuckoofilter;
+
+template <size_t bits_per_item, size_t num_candidate_buckets, template<size_t> class TableType>
+void Run(const char* name, size_t num_keys) {
+    DaryCuckooFilter<uint64_t, bits_per_item, num_candidate_buckets, TableType> filter(num_keys);
+    std::vector<uint64_t> keys = RandomHashes(num_keys, 1);
+    std::vector<uint64_t> others = RandomHashes(num_keys, 2);
+
+    // stop before the table fills up, the victim would end the run anyway
+    size_t num_inserted = num_keys * 0.95 * TableType<bits_per_item>::LoadThreshold(num_candidate_buckets);
+    Timer add;
+    for (size_t k = 0; k < num_inserted; k++) filter.AddHash(keys[k]);
+    double add_ns = add.NsPerOp(num_inserted);
+
+    size_t found = 0;
+    Timer hit;
+    for (size_t k = 0; k < num_inserted; k++) found += filter.ContainHash(keys[k]) == Ok;
+    double hit_ns = hit.NsPerOp(num_inserted);
+
+    Timer miss;
+    for (size_t k = 0; k < num_inserted; k++) found += filter.ContainHash(others[k]) == Ok;
+    double miss_ns = miss.NsPerOp(num_inserted);
+
+    std::cout << name << "\t" << bits_per_item << "\t" << num_candidate_buckets << "\t"
+              << filter.SizeInBytes() << "\t" << filter.BitsPerItem() << "\t"
+              << add_ns << "\t" << hit_ns << "\t" << miss_ns << "\t" << found << "\n";
+}
+
+template <size_t bits_per_item, size_t num_candidate_buckets>
+void Compare(size_t num_keys) {
+    Run<bits_per_item, num_candidate_buckets, PackedTable>("packed", num_keys);
+    Run<bits_per_item, num_candidate_buckets, CompactPackedTable>("compact", num_keys);
+}
+
+int main(int argc, char** argv) {
+    size_t num_keys = argc > 1 ? strtoull(argv[1], NULL, 10) : (1 << 22);
+
+    std::cout << "table\tbits\td\tbytes\tbits/item\tadd ns\thit ns\tmiss ns\tfound\n";
+    Compare<8, 2>(num_keys);
+    Compare<8, 4>(num_keys);
+    Compare<12, 3>(num_keys);
+    Compare<12, 4>(num_keys);
+    Compare<16, 5>(num_keys);
+    return 0;
+}
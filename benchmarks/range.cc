@@ -0,0 +1,77 @@
+// Range queries of RangeCuckooFilter against probing every key of the range
+// with Contain. Keys are spread over [0, 2^36); for every range width the
+// false positive rate is measured on ranges holding no key.
+// usage: range [num_keys] [num_queries]
+#include "rangecuckoofilter.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+using namespace d_ary_cuckoofilter;
+
+typedef RangeCuckooFilter<16, 4> Range;
+
+// naive range query, one point lookup per key of the range
+Status PointLoop(const Range& filter, uint64_t lo, uint64_t hi) {
+    for (uint64_t x = lo; ; x++) {
+        if (filter.Contain(x) == Ok) return Ok;
+        if (x == hi) return NotFound;
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t num_keys = argc > 1 ? strtoull(argv[1], NULL, 10) : (1 << 20);
+    size_t num_queries = argc > 2 ? strtoull(argv[2], NULL, 10) : 2000;
+    const uint64_t universe = 1ULL << 36;
+
+    std::vector<uint64_t> keys = RandomHashes(num_keys, 1);
+    for (size_t k = 0; k < num_keys; k++) keys[k] %= universe;
+    std::sort(keys.begin(), keys.end());
+
+    // random keys of 36 bits share all prefixes above level 8, and the levels
+    // in between hold fewer prefixes than keys
+    Range filter(num_keys, num_keys * 6);
+    for (size_t k = 0; k < num_keys; k++) filter.Add(keys[k]);
+    std::cout << "keys " << filter.Size() << ", prefixes " << filter.NumPrefixes()
+              << ", bits/key " << filter.BitsPerKey() << "\n";
+
+    std::cout << "width\tempty\trange fpr\trange ns\tloop fpr\tloop ns\n";
+    for (uint64_t width = 16; width <= (1 << 16); width *= 16) {
+        std::vector<uint64_t> los = RandomHashes(num_queries, width);
+        std::vector<bool> empty(num_queries);
+        size_t num_empty = 0;
+        for (size_t q = 0; q < num_queries; q++) {
+            los[q] %= universe - width;
+            std::vector<uint64_t>::iterator it = std::lower_bound(keys.begin(), keys.end(), los[q]);
+            empty[q] = it == keys.end() || *it > los[q] + width - 1;
+            num_empty += empty[q];
+        }
+
+        size_t range_fp = 0;
+        Timer range;
+        for (size_t q = 0; q < num_queries; q++) {
+            Status s = filter.ContainRange(los[q], los[q] + width - 1);
+            range_fp += empty[q] && s == Ok;
+        }
+        double range_ns = range.NsPerOp(num_queries);
+
+        // the point loop is only run on ranges it can finish quickly
+        size_t loop_fp = 0;
+        double loop_ns = 0;
+        if (width <= 4096) {
+            Timer loop;
+            for (size_t q = 0; q < num_queries; q++) {
+                Status s = PointLoop(filter, los[q], los[q] + width - 1);
+                loop_fp += empty[q] && s == Ok;
+            }
+            loop_ns = loop.NsPerOp(num_queries);
+        }
+
+        std::cout << width << "\t" << num_empty << "\t"
+                  << 1.0 * range_fp / num_empty << "\t" << range_ns << "\t"
+                  << 1.0 * loop_fp / num_empty << "\t" << loop_ns << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+// Throughput over table size, past 2^32 buckets where the index switches from
+// the high 32 bits of the hash to the whole remixed hash. Every table is filled
+// to 90% of its capacity; the largest one needs about max_keys bytes for its
+// 8-bit tags plus 16 bytes per key for the benchmark's own key arrays.
+// usage: scaling [max_keys]
+#include "d_ary_cuckoofilter.h"
+#include "timing.h"
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace d_ary_cuckoofilter;
+
+void Run(size_t num_keys) {
+    DaryCuckooFilter<uint64_t, 8, 4, SingleTable> filter(num_keys);
+    size_t num_inserted = num_keys * 0.9;
+    std::vector<uint64_t> keys = RandomHashes(num_inserted, 1);
+
+    Timer add;
+    for (size_t k = 0; k < num_inserted; k++) filter.AddHash(keys[k]);
+    double add_ns = add.NsPerOp(num_inserted);
+
+    size_t found = 0;
+    Timer hit;
+    for (size_t k = 0; k < num_inserted; k++) found += filter.ContainHash(keys[k]) == Ok;
+    double hit_ns = hit.NsPerOp(num_inserted);
+
+    keys = RandomHashes(num_inserted, 2);
+    Timer miss;
+    for (size_t k = 0; k < num_inserted; k++) found += filter.ContainHash(keys[k]) == Ok;
+    double miss_ns = miss.NsPerOp(num_inserted);
+
+    std::cout << filter.SizeInBuckets() << "\t"
+              << (filter.SizeInBuckets() > (1ULL << 32) ? "64" : "32") << "\t"
+              << filter.LoadFactor() << "\t" << add_ns << "\t"
+              << hit_ns << "\t" << miss_ns << "\t" << found << "\n";
+}
+
+int main(int argc, char** argv) {
+    size_t max_keys = argc > 1 ? strtoull(argv[1], NULL, 10) : (1ULL << 33);
+
+    std::cout << "buckets\tindex bits\tload\tadd ns\thit ns\tmiss ns\tfound\n";
+    for (size_t num_keys = 1 << 20; num_keys <= max_keys; num_keys *= 2) {
+        Run(num_keys);
+    }
+    return 0;
+}
@@ -0,0 +1,94 @@
+// Memory, false positive rate and lookup speed of FuseFilter against
+// DaryCuckooFilter over the same keys. A cuckoo filter of d candidates has a
+// false positive rate of about d * load / 2^bits, so at equal rate it needs
+// about log2(d) more bits per tag than a fuse filter. The "at fuse fpr" rows
+// give the size a cuckoo filter of d = 4 needs for the rate the fuse filter
+// measured, scaling its tags by the measured rates; a SingleTable only holds
+// 8, 16 and 32-bit tags, so this is computed rather than built.
+// usage: static_compare [num_keys]
+#include "d_ary_cuckoofilter.h"
+#include "fusefilter.h"
+#include "timing.h"
+
+#include <math.h>
+#include <cstdlib>
+#include <iostream>
+
+using namespace d_ary_cuckoofilter;
+
+// what a row measured
+struct Measured {
+    double bits_per_item;
+    double fpr;
+};
+
+// hit and miss lookups of filter, one line of output
+template <typename FilterType>
+Measured Report(const char* name, size_t bits, const FilterType& filter,
+            const std::vector<uint64_t>& keys, const std::vector<uint64_t>& others,
+            size_t num_inserted, double build_ns) {
+    size_t found = 0;
+    Timer hit;
+    for (size_t k = 0; k < num_inserted; k++) found += filter.ContainHash(keys[k]) == Ok;
+    double hit_ns = hit.NsPerOp(num_inserted);
+
+    size_t false_positives = 0;
+    Timer miss;
+    for (size_t k = 0; k < others.size(); k++) false_positives += filter.ContainHash(others[k]) == Ok;
+    double miss_ns = miss.NsPerOp(others.size());
+
+    std::cout << name << "\t" << bits << "\t" << filter.SizeInBytes() << "\t"
+              << 8.0 * filter.SizeInBytes() / num_inserted << "\t"
+              << 100.0 * false_positives / others.size() << "\t"
+              << build_ns << "\t" << hit_ns << "\t" << miss_ns << "\t"
+              << (found == num_inserted ? "ok" : "MISSING") << "\n";
+    return {8.0 * filter.SizeInBytes() / num_inserted, 1.0 * false_positives / others.size()};
+}
+
+// Size of a cuckoo filter of bits-bit tags for the rate of fuse instead. The
+// rate halves with every tag bit, so it takes log2(cuckoo.fpr / fuse.fpr) more.
+void ReportAtRate(const char* name, size_t bits, const Measured& cuckoo, const Measured& fuse) {
+    double tag_bits = bits + log2(cuckoo.fpr / fuse.fpr);
+    std::cout << name << " at fuse fpr\t" << tag_bits << "\t-\t"
+              << cuckoo.bits_per_item * tag_bits / bits << "\t"
+              << 100.0 * fuse.fpr << "\t-\t-\t-\t-\n";
+}
+
+template <size_t bits_per_item, size_t num_candidate_buckets>
+Measured RunCuckoo(size_t num_keys, const std::vector<uint64_t>& keys, const std::vector<uint64_t>& others) {
+    DaryCuckooFilter<uint64_t, bits_per_item, num_candidate_buckets, SingleTable> filter(num_keys);
+    // stop before the table fills up, the victim would end the run anyway
+    size_t num_inserted = num_keys * 0.95;
+    Timer add;
+    for (size_t k = 0; k < num_inserted; k++) filter.AddHash(keys[k]);
+    double add_ns = add.NsPerOp(num_inserted);
+    std::string name = "cuckoo d=" + std::to_string(num_candidate_buckets);
+    return Report(name.c_str(), bits_per_item, filter, keys, others, num_inserted, add_ns);
+}
+
+template <size_t bits_per_item>
+Measured RunFuse(size_t num_keys, const std::vector<uint64_t>& keys, const std::vector<uint64_t>& others) {
+    FuseFilter<uint64_t, bits_per_item> filter;
+    size_t num_inserted = num_keys * 0.95;
+    Timer build;
+    filter.BuildStaticHashes(keys.data(), num_inserted);
+    double build_ns = build.NsPerOp(num_inserted);
+    return Report("fuse", bits_per_item, filter, keys, others, num_inserted, build_ns);
+}
+
+int main(int argc, char** argv) {
+    size_t num_keys = argc > 1 ? strtoull(argv[1], NULL, 10) : (1 << 22);
+    std::vector<uint64_t> keys = RandomHashes(num_keys, 1);
+    std::vector<uint64_t> others = RandomHashes(num_keys, 2);
+
+    std::cout << "filter\tbits\tbytes\tbits/item\tfpr %\tbuild ns\thit ns\tmiss ns\tfound\n";
+    RunCuckoo<8, 3>(num_keys, keys, others);
+    Measured cuckoo8 = RunCuckoo<8, 4>(num_keys, keys, others);
+    Measured fuse8 = RunFuse<8>(num_keys, keys, others);
+    ReportAtRate("cuckoo d=4", 8, cuckoo8, fuse8);
+    RunCuckoo<16, 3>(num_keys, keys, others);
+    Measured cuckoo16 = RunCuckoo<16, 4>(num_keys, keys, others);
+    Measured fuse16 = RunFuse<16>(num_keys, keys, others);
+    ReportAtRate("cuckoo d=4", 16, cuckoo16, fuse16);
+    return 0;
+}
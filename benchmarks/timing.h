@@ -0,0 +1,41 @@
+// Helpers shared by the benchmarks: a wall clock timer and reproducible
+// pseudo-random 64-bit hashes to feed the pre-hashed entry points
+#ifndef _TIMING_H_
+#define _TIMING_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <chrono>
+#include <vector>
+
+namespace d_ary_cuckoofilter {
+
+    class Timer {
+        std::chrono::steady_clock::time_point start_;
+
+    public:
+        Timer(): start_(std::chrono::steady_clock::now()) {}
+
+        double Seconds() const {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        }
+
+        double NsPerOp(size_t ops) const {
+            return ops ? 1e9 * Seconds() / ops : 0;
+        }
+    };
+
+    // splitmix64, good enough to stand in for the hash of distinct keys
+    inline std::vector<uint64_t> RandomHashes(size_t n, uint64_t seed) {
+        std::vector<uint64_t> hvs(n);
+        for (size_t k = 0; k < n; k++) {
+            uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            hvs[k] = z ^ (z >> 31);
+        }
+        return hvs;
+    }
+}
+
+#endif // #ifndef _TIMING_H_
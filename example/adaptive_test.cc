@@ -0,0 +1,81 @@
+// An AdaptiveCuckooFilter with its keys in a VectorKeyMap. Every false
+// positive a query meets is reported, after which the query should miss
+// while no inserted key goes missing; deleting half the keys keeps the rest.
+#include "adaptivecuckoofilter.h"
+
+#include <cassert>
+#include <iostream>
+
+using d_ary_cuckoofilter::AdaptiveCuckooFilter;
+using d_ary_cuckoofilter::VectorKeyMap;
+using d_ary_cuckoofilter::Ok;
+using d_ary_cuckoofilter::NotFound;
+using d_ary_cuckoofilter::NotSupported;
+
+int main() {
+    size_t total_items = 1 << 16;
+    size_t total_queries = 1 << 18;
+
+    // 8-bit tags, so there are plenty of false positives to report
+    VectorKeyMap<uint64_t> keys;
+    AdaptiveCuckooFilter<uint64_t, 8, 4> filter(total_items, &keys);
+
+    size_t num_inserted = 0;
+    for (size_t i = 0; i < total_items; i++, num_inserted++) {
+        if (filter.Add(i) != Ok || filter.Size() != num_inserted + 1) {
+            break;
+        }
+    }
+    assert(num_inserted > total_items * 0.9);
+
+    // report every false positive among keys never inserted
+    size_t false_positives = 0;
+    size_t fixed = 0;
+    for (size_t i = total_items; i < total_items + total_queries; i++) {
+        if (filter.Contain(i) != Ok) continue;
+        false_positives++;
+        if (filter.ReportFalsePositive(i) != Ok) {
+            std::cout << "ReportFalsePositive found nothing to adapt for " << i << "\n";
+            return 1;
+        }
+        // the other fingerprint of a stored key may collide too, rarely
+        fixed += filter.Contain(i) == NotFound;
+    }
+    std::cout << fixed << " of " << false_positives << " false positives fixed, "
+              << filter.NumAdapted() << " slots adapted\n";
+    assert(false_positives > 0 && fixed >= false_positives * 0.95);
+
+    // adapted slots still hold their keys
+    for (size_t i = 0; i < num_inserted; i++) {
+        assert(filter.Contain(i) == Ok);
+    }
+
+    // The same queries a second time meet far fewer false positives. Some come
+    // back: a slot adapted for one query may collide with another in its new
+    // fingerprint, or be switched back by a later report.
+    size_t second_false_positives = 0;
+    for (size_t i = total_items; i < total_items + total_queries; i++) {
+        second_false_positives += filter.Contain(i) == Ok;
+    }
+    std::cout << second_false_positives << " false positives on a second pass\n";
+    assert(second_false_positives < false_positives / 4);
+
+    // Delete removes exactly the key asked for, even from an adapted slot
+    for (size_t i = 0; i < num_inserted; i += 2) {
+        if (filter.Delete(i) != Ok) {
+            std::cout << "Delete failed at " << i << "\n";
+            return 1;
+        }
+    }
+    assert(filter.Size() == num_inserted / 2);
+    for (size_t i = 1; i < num_inserted; i += 2) {
+        assert(filter.Contain(i) == Ok);
+    }
+
+    // without a key map nothing can be adapted
+    AdaptiveCuckooFilter<uint64_t, 8, 4> plain(total_items);
+    assert(plain.Add(1) == Ok);
+    assert(plain.ReportFalsePositive(2) == NotSupported);
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+// CompactPackedTable reads and writes every slot with an unaligned 64-bit
+// word that also covers its neighbours. Every slot, up to the last one, gets
+// a tag and a mark and keeps them while the slots around it change. The
+// tuner reports the size of compact tables the filter itself has.
+#include "compactpackedtable.h"
+#include "tuner.h"
+
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace d_ary_cuckoofilter;
+
+// the number of slots whose tag or mark differ from what was last written
+template <size_t bits_per_tag>
+static size_t Mismatches(const CompactPackedTable<bits_per_tag>& table,
+                         const std::vector<size_t>& index, const std::vector<uint32_t>& tag) {
+    size_t bad = 0;
+    for (size_t s = 0; s < index.size(); s++) {
+        bad += table.ReadTag(index[s]) != tag[s] || !table.FindTagInBucket(index[s], tag[s]) ||
+               table.IndexOfSlot(s) != index[s];
+    }
+    return bad;
+}
+
+// fill every slot in random order, then overwrite every other slot and
+// clear a few, checking all slots after each round
+template <size_t bits_per_tag>
+static bool Check(size_t num_candidate_buckets, size_t max_num_keys) {
+    typedef CompactPackedTable<bits_per_tag> Table;
+    Table table(num_candidate_buckets, max_num_keys);
+    const size_t n = table.SizeInBuckets();
+    std::mt19937_64 rng(n * 131 + bits_per_tag);
+
+    // slot s holds an index s + m * n below the mock table size, so its mark is m
+    std::vector<size_t> index(n);
+    std::vector<uint32_t> tag(n);
+    const size_t max_mark = (table.HashTableSize() - 1) / n;
+    for (size_t s = 0; s < n; s++) {
+        size_t mark = rng() % (max_mark + 1);
+        if (s + mark * n >= table.HashTableSize()) mark = 0;
+        index[s] = s + mark * n;
+        tag[s] = 1 + rng() % Table::TAGMASK;
+    }
+    // all bits set at both ends of the table, the last slot with its largest mark
+    tag[0] = tag[n - 1] = Table::TAGMASK;
+    index[n - 1] = n - 1;
+    while (index[n - 1] + n < table.HashTableSize()) index[n - 1] += n;
+
+    std::vector<size_t> order(n);
+    for (size_t s = 0; s < n; s++) order[s] = s;
+    std::shuffle(order.begin(), order.end(), rng);
+    for (size_t k = 0; k < n; k++) {
+        table.WriteTag(index[order[k]], tag[order[k]]);
+    }
+    size_t bad = Mismatches(table, index, tag);
+
+    for (size_t s = n % 2; s < n; s += 2) {
+        tag[s] = 1 + rng() % Table::TAGMASK;
+        table.WriteTag(index[s], tag[s]);
+    }
+    bad += Mismatches(table, index, tag);
+
+    // a cleared slot reads as empty with mark 0
+    for (size_t s = 0; s < n; s += 7) {
+        index[s] = s;
+        tag[s] = 0;
+        table.WriteTag(s, 0);
+    }
+    table.WriteTag(n - 1, 0);
+    index[n - 1] = n - 1;
+    tag[n - 1] = 0;
+    bad += Mismatches(table, index, tag);
+
+    std::cout << bits_per_tag << "-bit tags, " << num_candidate_buckets << "-ary, " << n
+              << " slots: " << bad << " mismatches\n";
+    return bad == 0;
+}
+
+int main() {
+    bool ok = true;
+    // slot widths that are odd, a multiple of 8, and as wide as a slot gets
+    ok = Check<5>(2, 1000) && ok;
+    ok = Check<5>(3, 12345) && ok;
+    ok = Check<13>(4, 40000) && ok;
+    ok = Check<14>(8, 40000) && ok;
+    ok = Check<16>(5, 3333) && ok;
+    ok = Check<29>(8, 20000) && ok;
+    ok = Check<32>(7, 20000) && ok;
+    assert(ok);
+
+    // sample and full table are the same size here, so the reported size and
+    // bits per key are exactly those of a filter for expected_keys items
+    TunerOptions opts;
+    opts.expected_keys = 10007;
+    opts.sample_keys = opts.expected_keys;
+    std::vector<TunedConfig> configs = Tuner::Evaluate(opts);
+    DaryCuckooFilter<uint64_t, 16, 4, CompactPackedTable> filter(opts.expected_keys);
+    const size_t num_keys = opts.expected_keys * 0.9;
+    for (size_t i = 0; i < num_keys; i++) {
+        if (filter.Add(i) != Ok) return 1;
+    }
+    size_t num_compact = 0;
+    for (size_t k = 0; k < configs.size(); k++) {
+        const TunedConfig& c = configs[k];
+        if (c.table != "CompactPackedTable" || c.bits_per_item != 16 ||
+            c.num_candidate_buckets != 4) continue;
+        num_compact++;
+        // the filter holds fewer keys, scale its bits per key to expected_keys
+        const double bits_per_key = filter.BitsPerItem() * filter.Size() / opts.expected_keys;
+        std::cout << "tuner: " << c.bits_per_key << " bits per key, filter: "
+                  << bits_per_key << "\n";
+        assert(c.size_in_bytes == filter.SizeInBytes());
+        assert(fabs(c.bits_per_key - bits_per_key) < 1e-9);
+    }
+    assert(num_compact == 1);
+    return ok ? 0 : 1;
+}
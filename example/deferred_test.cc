@@ -0,0 +1,73 @@
+// Deferred inserts fill a table to 97% while the worker kicks queued items
+// into it in the background; every lookup path has to find an item as soon as
+// Add returns, and Delete has to reach items still queued
+#include "d_ary_cuckoofilter.h"
+#include "interleavedlookup.h"
+
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+using namespace d_ary_cuckoofilter;
+
+int main() {
+    size_t total_items = 1 << 18;
+    typedef DaryCuckooFilter<uint64_t, 16, 4, SingleTable> Filter;
+    Filter filter(total_items);
+    filter.EnableDeferredInserts();
+
+    // fill the table far enough that items start to queue
+    size_t num_inserted = total_items * 0.97;
+    std::vector<uint64_t> hvs(num_inserted);
+    std::vector<Status> statuses(num_inserted);
+    size_t max_queued = 0;
+    for (size_t i = 0; i < num_inserted; i++) {
+        hvs[i] = Filter::Hash(i);
+        if (filter.AddHash(hvs[i]) != Ok) {
+            std::cout << "AddHash failed at " << i << "\n";
+            return 1;
+        }
+        assert(filter.ContainHash(hvs[i]) == Ok);
+        filter.ContainHashBatch(&hvs[i], 1, &statuses[i]);
+        assert(statuses[i] == Ok);
+        max_queued = std::max(max_queued, filter.NumDeferred());
+    }
+    assert(filter.Size() == num_inserted);
+
+    // batches and interleaved lookups of everything, worker still running
+    filter.ContainHashBatch(hvs.data(), num_inserted, statuses.data());
+    for (size_t i = 0; i < num_inserted; i++) {
+        assert(statuses[i] == Ok);
+    }
+    size_t found = 0;
+    InterleavedLookup<Filter> lookups(filter, [&](uint64_t, Status status) {
+        found += status == Ok;
+    });
+    for (size_t i = 0; i < num_inserted; i++) {
+        lookups.SubmitHash(hvs[i], i);
+    }
+    lookups.Drain();
+    assert(found == num_inserted);
+
+    // deletes reach queued items too
+    size_t num_deleted = 0;
+    for (size_t i = 0; i < num_inserted; i += 2) {
+        num_deleted += filter.DeleteHash(hvs[i]) == Ok;
+    }
+    assert(num_deleted == (num_inserted + 1) / 2);
+    filter.FlushDeferred();
+    assert(filter.NumDeferred() == 0);
+    for (size_t i = 1; i < num_inserted; i += 2) {
+        assert(filter.ContainHash(hvs[i]) == Ok);
+    }
+    assert(filter.Size() == num_inserted - num_deleted);
+
+    filter.DisableDeferredInserts();
+    for (size_t i = 1; i < num_inserted; i += 2) {
+        assert(filter.Contain(i) == Ok);
+    }
+
+    std::cout << "At most " << max_queued << " of " << num_inserted
+              << " items were queued at once\n";
+    return 0;
+}
@@ -0,0 +1,115 @@
+// A primary ships its changes to replicas as deltas. One replica applies
+// every delta, a late one misses a delta and catches up from a snapshot, and
+// a truncated delta is refused without touching the replica.
+#include "d_ary_cuckoofilter.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using d_ary_cuckoofilter::FilterDelta;
+using d_ary_cuckoofilter::Status;
+using d_ary_cuckoofilter::Ok;
+using d_ary_cuckoofilter::NotFound;
+using d_ary_cuckoofilter::NotSupported;
+
+typedef d_ary_cuckoofilter::DaryCuckooFilter<uint64_t, 16, 4, d_ary_cuckoofilter::SingleTable> Filter;
+
+// a call the rest of the test builds on, so it runs whatever NDEBUG says
+static void Expect(Status status, Status expected, const char* call) {
+    if (status != expected) {
+        std::cout << call << " returned " << status << "\n";
+        exit(1);
+    }
+}
+
+// ship a delta the way a primary would, through its serialized form
+static Status Ship(const FilterDelta& delta, Filter* replica) {
+    FilterDelta received;
+    if (!received.Deserialize(delta.Serialize())) return NotSupported;
+    return replica->ApplyDelta(received);
+}
+
+int main() {
+    size_t total_items = 1 << 16;
+    size_t num_rounds = 4;
+    size_t per_round = total_items * 0.9 / num_rounds;
+
+    Filter primary(total_items);
+    Filter replica(total_items);
+    Filter late(total_items);
+    primary.EnableDeltaTracking();
+
+    FilterDelta delta;
+    size_t added = 0;
+    for (size_t round = 0; round < num_rounds; round++) {
+        for (size_t i = 0; i < per_round; i++, added++) {
+            Expect(primary.Add(added), Ok, "Add");
+        }
+        // every other round deletes a few of the items of the previous one
+        if (round % 2 == 1) {
+            for (size_t i = added - 2 * per_round; i < added - per_round; i += 7) {
+                Expect(primary.Delete(i), Ok, "Delete");
+            }
+        }
+        Expect(primary.ExportDelta(&delta), Ok, "ExportDelta");
+        Expect(Ship(delta, &replica), Ok, "ApplyDelta");
+        // applying it again does nothing
+        Expect(Ship(delta, &replica), Ok, "ApplyDelta");
+        assert(replica.DeltaVersion() == primary.DeltaVersion());
+        assert(replica.Size() == primary.Size());
+
+        // the late replica sees the first delta and misses the second, so it
+        // can apply none after that
+        if (round == 0) {
+            Expect(Ship(delta, &late), Ok, "ApplyDelta");
+        } else if (round > 1) {
+            Expect(Ship(delta, &late), NotSupported, "ApplyDelta");
+        }
+    }
+    for (size_t i = 0; i < added; i++) {
+        assert(replica.Contain(i) == primary.Contain(i));
+    }
+
+    // a snapshot catches the late replica up and leaves the primary's next
+    // delta alone
+    FilterDelta snapshot;
+    primary.ExportSnapshot(&snapshot);
+    assert(snapshot.base_version == 0);
+    assert(snapshot.version == primary.DeltaVersion());
+    Expect(Ship(snapshot, &late), Ok, "ApplyDelta");
+    assert(late.DeltaVersion() == primary.DeltaVersion());
+    assert(late.Size() == primary.Size());
+    for (size_t i = 0; i < added; i++) {
+        assert(late.Contain(i) == primary.Contain(i));
+    }
+    Expect(primary.ExportDelta(&delta), Ok, "ExportDelta");
+    assert(delta.pages.empty());
+    Expect(Ship(delta, &late), Ok, "ApplyDelta");
+
+    // a snapshot also starts a replica that was never tracked at all
+    Filter fresh(total_items);
+    Expect(Ship(snapshot, &fresh), Ok, "ApplyDelta");
+    assert(fresh.Size() == primary.Size());
+
+    // a truncated delta is rejected before any page is copied
+    Expect(primary.Add(added), Ok, "Add");
+    Expect(primary.ExportDelta(&delta), Ok, "ExportDelta");
+    FilterDelta truncated = delta;
+    truncated.data.resize(truncated.data.size() - 1);
+    uint64_t version = late.DeltaVersion();
+    size_t size = late.Size();
+    Expect(late.ApplyDelta(truncated), NotSupported, "ApplyDelta");
+    if (late.DeltaVersion() != version || late.Size() != size) {
+        std::cout << "a truncated delta changed the replica\n";
+        return 1;
+    }
+    assert(late.Contain(added) == NotFound);
+    Expect(Ship(delta, &late), Ok, "ApplyDelta");
+    assert(late.Contain(added) == Ok);
+
+    std::cout << "Deltas: " << added + 1 << " items in " << primary.DeltaVersion()
+              << " deltas, " << snapshot.data.size() << " bytes per snapshot\n";
+    return 0;
+}
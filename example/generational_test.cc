@@ -0,0 +1,80 @@
+// A GenerationalCuckooFilter run through more generations than its 8-bit
+// generation numbers count, so every number is reused a few times. Keys of the
+// live window are always found, and keys of expired generations, including
+// those whose number is the current one again, are found no more often than
+// keys that were never added.
+#include "generationalcuckoofilter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+using d_ary_cuckoofilter::GenerationalCuckooFilter;
+using d_ary_cuckoofilter::Ok;
+
+typedef GenerationalCuckooFilter<uint64_t, 16, 4> Filter;
+
+// the k-th key added in generation g
+static uint64_t Key(uint64_t g, size_t k) {
+    return (g << 32) | k;
+}
+
+// A burst fills most of the table every 64 generations, the others add a few
+// keys, so the slots of a burst mostly stay where they are after it expires
+// until its generation number comes around again.
+static size_t NumKeys(uint64_t g, size_t max_live_keys) {
+    return g % 64 == 0 ? max_live_keys * 0.8 : 32;
+}
+
+int main() {
+    size_t max_live_keys = 1 << 14;
+    size_t num_generations = 8;
+    uint64_t num_rounds = 600;
+    Filter filter(max_live_keys, num_generations);
+
+    size_t num_missing = 0;
+    size_t expired_queries = 0;
+    size_t expired_positives = 0;
+    size_t fresh_positives = 0;
+    for (uint64_t g = 0; g < num_rounds; g++) {
+        if (g > 0) filter.Advance();
+        for (size_t k = 0; k < NumKeys(g, max_live_keys); k++) {
+            if (filter.Add(Key(g, k)) != Ok) {
+                std::cout << "Add failed in generation " << g << "\n";
+                return 1;
+            }
+        }
+
+        // the live window
+        size_t num_live = 0;
+        for (uint64_t l = g + 1 - std::min(g + 1, (uint64_t) num_generations); l <= g; l++) {
+            for (size_t k = 0; k < NumKeys(l, max_live_keys); k++, num_live++) {
+                num_missing += filter.Contain(Key(l, k)) != Ok;
+            }
+        }
+        if (filter.Size() != num_live) {
+            std::cout << "generation " << g << " holds " << filter.Size() << " items\n";
+            return 1;
+        }
+
+        // the generation that just expired, one halfway through the period,
+        // and those 256 and 512 back, whose numbers are the current one
+        const uint64_t back[] = {num_generations, 128, 256, 512};
+        for (size_t b = 0; b < sizeof(back) / sizeof(back[0]); b++) {
+            if (g < back[b]) continue;
+            for (size_t k = 0; k < NumKeys(g - back[b], max_live_keys); k++) {
+                expired_queries++;
+                expired_positives += filter.Contain(Key(g - back[b], k)) == Ok;
+                fresh_positives += filter.Contain(Key(num_rounds + g, (b << 24) + k)) == Ok;
+            }
+        }
+    }
+
+    std::cout << num_rounds << " generations, " << num_missing << " live keys missing, "
+              << expired_positives << " expired and " << fresh_positives
+              << " never added keys found of " << expired_queries << " each\n";
+    assert(num_missing == 0);
+    assert(expired_queries > 0);
+    assert(expired_positives <= 2 * fresh_positives + 10);
+    return num_missing == 0 ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+// Promotion of hot items: keys looked up often past their first candidate
+// are moved there by PromoteHotItems, so a lookup decides at its first probe,
+// and every key stays in the filter. Intersect looks the other filter up
+// without counting anything.
+#include "d_ary_cuckoofilter.h"
+
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+using namespace d_ary_cuckoofilter;
+
+typedef DaryCuckooFilter<uint64_t, 16, 4, SingleTable> Filter;
+
+// the number of candidates an interleaved lookup of key probes before it
+// decides, 1 if found under its first candidate
+static size_t Probes(const Filter& filter, uint64_t key) {
+    Filter::LookupState state;
+    Status status;
+    filter.LookupBegin(Filter::Hash(key), &state);
+    while (!filter.LookupStep(&state, &status)) {}
+    assert(status == Ok);
+    return state.step + 1;
+}
+
+int main() {
+    size_t total_items = 1 << 16;
+    Filter filter(total_items);
+    // half full, so the occupant of a first candidate mostly finds room in
+    // another of its own
+    size_t num_inserted = total_items / 2;
+    for (size_t i = 0; i < num_inserted; i++) {
+        if (filter.Add(i) != Ok) return 1;
+    }
+
+    // every lookup counts, and the hot ones are those past their first candidate
+    filter.EnableHotnessTracking(1 << 16, 0);
+    std::vector<uint64_t> hot;
+    for (size_t i = 0; i < num_inserted && hot.size() < 300; i++) {
+        if (Probes(filter, i) > 1) hot.push_back(i);
+    }
+    // seen by three more lookup paths, which reaches the threshold of 4
+    std::vector<uint64_t> hvs;
+    size_t found = 0;
+    for (size_t k = 0; k < hot.size(); k++) {
+        hvs.push_back(Filter::Hash(hot[k]));
+        found += filter.Contain(hot[k]) == Ok;
+        found += filter.ContainHash(hvs[k]) == Ok;
+    }
+    std::vector<Status> statuses(hvs.size());
+    filter.ContainHashBatch(hvs.data(), hvs.size(), statuses.data());
+    for (size_t k = 0; k < hot.size(); k++) {
+        found += statuses[k] == Ok;
+    }
+    assert(found == 3 * hot.size());
+
+    size_t moved = filter.PromoteHotItems();
+    size_t first = 0;
+    for (size_t k = 0; k < hot.size(); k++) {
+        first += Probes(filter, hot[k]) == 1;
+    }
+    std::cout << moved << " of " << hot.size() << " hot items promoted, "
+              << first << " now found at their first probe\n";
+    // an occupant kicked out may be another promoted item
+    assert(moved > hot.size() / 2 && first > hot.size() / 2);
+
+    // nothing is lost or counted twice
+    assert(filter.Size() == num_inserted);
+    for (size_t i = 0; i < num_inserted; i++) {
+        assert(filter.Contain(i) == Ok);
+    }
+
+    // the lookups of Intersect leave the hotness of the other filter alone
+    Filter other(total_items);
+    for (size_t i = 0; i < num_inserted; i++) {
+        if (other.Add(i) != Ok) return 1;
+    }
+    other.EnableHotnessTracking(1 << 16, 0);
+    for (size_t r = 0; r < 8; r++) {
+        Filter copy(total_items);
+        if (copy.Merge(filter) != Ok || copy.Intersect(other) != Ok) return 1;
+    }
+    assert(other.PromoteHotItems() == 0);
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+// DaryCuckooMap with several tag and value widths: Add, Lookup, Update and
+// Delete. Lookup never returns the value of another key; when keys sharing a
+// tag hold different values it returns nothing, which 4-bit tags make common.
+#include "d_ary_cuckoomap.h"
+
+#include <cassert>
+#include <iostream>
+
+using d_ary_cuckoofilter::DaryCuckooMap;
+using d_ary_cuckoofilter::Ok;
+using d_ary_cuckoofilter::NotFound;
+using d_ary_cuckoofilter::NotSupported;
+
+// lookups of keys first..last returning another value than value(key), and
+// those returning nothing
+template <typename Map, typename F>
+static void Count(const Map& map, uint64_t first, uint64_t last, F value,
+                  size_t* wrong, size_t* conflicts) {
+    for (uint64_t key = first; key < last; key++) {
+        std::optional<uint32_t> v = map.Lookup(key);
+        *wrong += v && *v != value(key);
+        *conflicts += !v;
+    }
+}
+
+template <size_t bits_per_item, size_t bits_per_value, size_t num_candidate_buckets>
+static bool Check(size_t total_items) {
+    typedef DaryCuckooMap<uint64_t, bits_per_item, bits_per_value, num_candidate_buckets> Map;
+    const uint64_t num_values = (uint64_t) Map::kMaxValue + 1;
+    auto added = [&](uint64_t key) { return (uint32_t) ((key * 7) % num_values); };
+    auto updated = [&](uint64_t key) { return (uint32_t) ((key * 7 + 1) % num_values); };
+
+    Map map(total_items);
+    size_t num_inserted = total_items * 0.9;
+    for (size_t key = 0; key < num_inserted; key++) {
+        if (map.Add(key, added(key)) != Ok) return false;
+    }
+    bool ok = map.Size() == num_inserted;
+    if (bits_per_value < 32) {
+        ok = ok && map.Add(num_inserted, Map::kMaxValue + 1) == NotSupported;
+        ok = ok && map.Update(0, Map::kMaxValue + 1) == NotSupported;
+    }
+
+    // every key is a member and none gets another key's value
+    size_t missing = 0;
+    for (size_t key = 0; key < num_inserted; key++) {
+        missing += map.Contain(key) != Ok;
+    }
+    size_t wrong = 0;
+    size_t conflicts = 0;
+    Count(map, 0, num_inserted, added, &wrong, &conflicts);
+    ok = ok && missing == 0 && wrong == 0;
+
+    // Update writes every slot matching a key, so a key sharing the tag of a
+    // later one may take its value
+    for (size_t key = 0; key < num_inserted; key++) {
+        if (map.Update(key, updated(key)) != Ok) ok = false;
+    }
+    size_t wrong_updated = 0;
+    size_t conflicts_updated = 0;
+    Count(map, 0, num_inserted, updated, &wrong_updated, &conflicts_updated);
+    const size_t bound = 2.0 * num_inserted * num_candidate_buckets / (1ULL << bits_per_item) + 10;
+    ok = ok && wrong_updated + conflicts_updated <= bound;
+
+    // delete the even keys, the odd ones stay unless a deleted key took the
+    // slot of one sharing its tag
+    for (size_t key = 0; key < num_inserted; key += 2) {
+        if (map.Delete(key) != Ok) ok = false;
+    }
+    ok = ok && map.Size() == num_inserted - (num_inserted + 1) / 2;
+    for (size_t key = 1; key < num_inserted; key += 2) {
+        missing += map.Contain(key) != Ok;
+    }
+    ok = ok && missing <= bound;
+
+    // keys never added
+    size_t found = 0;
+    for (size_t key = total_items; key < 2 * total_items; key++) {
+        found += map.Lookup(key).has_value();
+    }
+    ok = ok && found <= bound;
+
+    std::cout << bits_per_item << "-bit tags, " << bits_per_value << "-bit values, "
+              << num_candidate_buckets << "-ary: " << conflicts << " conflicts, "
+              << wrong_updated << " wrong and " << conflicts_updated << " conflicts after Update, "
+              << missing << " lost by Delete, " << found << " of " << total_items << " absent keys found\n";
+    return ok;
+}
+
+int main() {
+    bool ok = true;
+    ok = Check<4, 8, 4>(1 << 14) && ok;
+    ok = Check<8, 8, 3>(1 << 16) && ok;
+    ok = Check<12, 4, 4>(1 << 16) && ok;
+    ok = Check<16, 16, 4>(1 << 16) && ok;
+    ok = Check<16, 1, 2>(1 << 16) && ok;
+    ok = Check<32, 32, 8>(1 << 16) && ok;
+    assert(ok);
+    return ok ? 0 : 1;
+}
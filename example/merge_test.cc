@@ -0,0 +1,84 @@
+// Filters built as shards over disjoint keys and combined again: Merge one
+// shard at a time, MergeShards of all of them, and Intersect
+#include "d_ary_cuckoofilter.h"
+
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+using d_ary_cuckoofilter::DaryCuckooFilter;
+using d_ary_cuckoofilter::Ok;
+using d_ary_cuckoofilter::NotSupported;
+
+typedef DaryCuckooFilter<uint64_t, 16, 4, d_ary_cuckoofilter::SingleTable> Filter;
+
+int main() {
+    size_t total_items = 1 << 18;
+    size_t num_shards = 4;
+    size_t per_shard = total_items * 0.9 / num_shards;
+
+    // shard k holds the items i with i % num_shards == k
+    std::vector<Filter*> shards;
+    size_t num_inserted = 0;
+    for (size_t k = 0; k < num_shards; k++) {
+        shards.push_back(new Filter(total_items));
+        for (size_t i = k; i < per_shard * num_shards; i += num_shards, num_inserted++) {
+            if (shards[k]->Add(i) != Ok) {
+                break;
+            }
+        }
+    }
+    assert(num_inserted == per_shard * num_shards);
+
+    // Merge two shards one at a time
+    Filter merged(total_items);
+    if (merged.Merge(*shards[0]) != Ok || merged.Merge(*shards[1]) != Ok) {
+        std::cout << "Merge failed\n";
+        return 1;
+    }
+    assert(merged.Size() == 2 * per_shard);
+    for (size_t i = 0; i < num_inserted; i++) {
+        if (i % num_shards < 2) assert(merged.Contain(i) == Ok);
+    }
+
+    // MergeShards of all shards on two threads, expected to find every item
+    std::vector<const Filter*> all(shards.begin(), shards.end());
+    Filter combined(total_items);
+    if (Filter::MergeShards(all, &combined, 2) != Ok) {
+        std::cout << "MergeShards failed\n";
+        return 1;
+    }
+    assert(combined.Size() == num_inserted);
+    for (size_t i = 0; i < num_inserted; i++) {
+        assert(combined.Contain(i) == Ok);
+    }
+
+    // shards 0 and 1 intersected with shards 1 and 2 leave shard 1, and a few
+    // false positives of shard 0
+    Filter other(total_items);
+    if (other.Merge(*shards[1]) != Ok || other.Merge(*shards[2]) != Ok ||
+        merged.Intersect(other) != Ok) {
+        std::cout << "Intersect failed\n";
+        return 1;
+    }
+    for (size_t i = 1; i < num_inserted; i += num_shards) {
+        assert(merged.Contain(i) == Ok);
+    }
+    size_t false_positives = 0;
+    for (size_t i = 0; i < num_inserted; i += num_shards) {
+        false_positives += merged.Contain(i) == Ok;
+    }
+    assert(merged.Size() >= per_shard && merged.Size() - per_shard <= false_positives);
+
+    // tables of another size do not combine, and are left as they were
+    Filter smaller(total_items / 4);
+    assert(smaller.Merge(*shards[0]) == NotSupported);
+    assert(smaller.Intersect(*shards[0]) == NotSupported);
+    assert(Filter::MergeShards(all, &smaller, 1) == NotSupported);
+    assert(smaller.Size() == 0);
+
+    std::cout << "Intersect kept " << false_positives << " of " << per_shard
+              << " items of a dropped shard\n";
+    for (size_t k = 0; k < num_shards; k++) delete shards[k];
+    return 0;
+}
@@ -0,0 +1,54 @@
+// ParallelBuild on top of items added one by one: every key is found and
+// counted whatever the number of threads, also for PackedTable, whose marks
+// make it build on a single range
+#include "d_ary_cuckoofilter.h"
+
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+using d_ary_cuckoofilter::DaryCuckooFilter;
+using d_ary_cuckoofilter::Ok;
+
+// the number of keys found after building, expected keys.size()
+template <template<size_t> class TableType>
+size_t Build(const std::vector<uint64_t>& keys, size_t total_items, size_t num_threads) {
+    DaryCuckooFilter<uint64_t, 16, 4, TableType> filter(total_items);
+
+    size_t num_serial = keys.size() / 10;
+    for (size_t i = 0; i < num_serial; i++) {
+        if (filter.Add(keys[i]) != Ok) {
+            return i;
+        }
+    }
+    if (filter.ParallelBuild(keys.data() + num_serial, keys.size() - num_serial, num_threads) != Ok) {
+        return num_serial;
+    }
+    assert(filter.Size() == keys.size());
+
+    size_t found = 0;
+    for (size_t i = 0; i < keys.size(); i++) {
+        found += filter.Contain(keys[i]) == Ok;
+    }
+    return found;
+}
+
+int main() {
+    size_t total_items = 1 << 18;
+    size_t num_inserted = total_items * 0.9;
+    std::vector<uint64_t> keys(num_inserted);
+    for (size_t i = 0; i < num_inserted; i++) {
+        keys[i] = i;
+    }
+
+    for (size_t num_threads = 1; num_threads <= 8; num_threads *= 2) {
+        size_t found = Build<d_ary_cuckoofilter::SingleTable>(keys, total_items, num_threads);
+        std::cout << num_threads << " threads: " << found << " of " << num_inserted << " found\n";
+        assert(found == num_inserted);
+    }
+    size_t found = Build<d_ary_cuckoofilter::PackedTable>(keys, total_items, 4);
+    std::cout << "PackedTable: " << found << " of " << num_inserted << " found\n";
+    assert(found == num_inserted);
+
+    return 0;
+}
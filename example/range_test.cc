@@ -0,0 +1,76 @@
+// ContainRange of RangeCuckooFilter never misses a key in the range: single
+// keys, ranges reaching 0 or 2^64 - 1, random widths around every key, and
+// the whole key space. Keys at both ends of the key space are stored too.
+#include "rangecuckoofilter.h"
+
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using d_ary_cuckoofilter::RangeCuckooFilter;
+using d_ary_cuckoofilter::Ok;
+using d_ary_cuckoofilter::NotFound;
+
+typedef RangeCuckooFilter<16, 4> Range;
+
+int main() {
+    const uint64_t kMax = ~0ULL;
+    std::mt19937_64 rng(20261018);
+
+    // random keys, a dense run of nearby ones, and both ends of the key space
+    std::vector<uint64_t> keys;
+    for (size_t k = 0; k < 20000; k++) keys.push_back(rng());
+    const uint64_t base = rng() >> 8;
+    for (size_t k = 0; k < 5000; k++) keys.push_back(base + 3 * k);
+    keys.push_back(0);
+    keys.push_back(kMax);
+    keys.push_back(1ULL << 63);
+
+    Range empty(16);
+    assert(empty.ContainRange(0, kMax) == NotFound);
+
+    Range filter(keys.size());
+    for (size_t k = 0; k < keys.size(); k++) {
+        if (filter.Add(keys[k]) != Ok) {
+            std::cout << "Add failed after " << k << " keys\n";
+            return 1;
+        }
+    }
+    assert(filter.ContainRange(1, 0) == NotFound);
+
+    size_t misses = 0;
+    size_t queries = 0;
+    for (size_t k = 0; k < keys.size(); k++) {
+        const uint64_t x = keys[k];
+        // widths of up to 2^62, cut at both ends of the key space
+        const uint64_t below = rng() >> (2 + rng() % 62);
+        const uint64_t above = rng() >> (2 + rng() % 62);
+        const uint64_t lo = x >= below ? x - below : 0;
+        const uint64_t hi = kMax - x >= above ? x + above : kMax;
+        misses += filter.ContainRange(x, x) != Ok;
+        misses += filter.ContainRange(0, x) != Ok;
+        misses += filter.ContainRange(x, kMax) != Ok;
+        misses += filter.ContainRange(lo, x) != Ok;
+        misses += filter.ContainRange(x, hi) != Ok;
+        misses += filter.ContainRange(lo, hi) != Ok;
+        queries += 6;
+    }
+    misses += filter.ContainRange(0, 0) != Ok;
+    misses += filter.ContainRange(kMax, kMax) != Ok;
+    misses += filter.ContainRange(0, kMax) != Ok;
+    queries += 3;
+
+    // single values next to keys are mostly absent
+    size_t false_positives = 0;
+    for (size_t k = 0; k < keys.size(); k++) {
+        const uint64_t x = keys[k] ^ (1ULL << 40);
+        false_positives += filter.ContainRange(x, x) == Ok;
+    }
+
+    std::cout << misses << " of " << queries << " ranges holding a key missed, "
+              << false_positives << " of " << keys.size() << " absent single keys found\n";
+    assert(misses == 0);
+    assert(false_positives < keys.size() / 10);
+    return misses == 0 ? 0 : 1;
+}
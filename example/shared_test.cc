@@ -0,0 +1,110 @@
+// A SharedCuckooFilter in a memfd mapped twice MAP_SHARED: the writer adds
+// through one mapping while a forked reader looks keys up through the other
+// and never misses one added before it attached. A writer that died inside a
+// write makes readers give up with IOError.
+#include "sharedcuckoofilter.h"
+
+#include <cassert>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace d_ary_cuckoofilter;
+
+typedef SharedCuckooFilter<uint64_t, 16, 4> Filter;
+
+static void* Map(int fd, size_t bytes) {
+    void* p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    return p == MAP_FAILED ? NULL : p;
+}
+
+int main() {
+    const size_t total_items = 1 << 16;
+    const size_t num_before = total_items / 2;
+    const size_t num_after = total_items * 0.9;
+    const size_t bytes = Filter::RequiredBytes(total_items);
+
+    int fd = memfd_create("shared_test", 0);
+    if (fd < 0 || ftruncate(fd, bytes) != 0) {
+        return 1;
+    }
+    void* writer_region = Map(fd, bytes);
+    void* reader_region = Map(fd, bytes);
+    // set once the writer is done, in a page of its own
+    std::atomic<int>* done = (std::atomic<int>*) mmap(NULL, sizeof(std::atomic<int>),
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (!writer_region || !reader_region || done == MAP_FAILED) {
+        return 1;
+    }
+    done->store(0);
+
+    // nothing to attach to yet, and no room for a larger filter
+    {
+        Filter early(reader_region, bytes);
+        assert(early.Attach() == NotSupported);
+        Filter larger(writer_region, bytes);
+        assert(larger.Create(2 * total_items) == NotEnoughSpace);
+    }
+
+    Filter writer(writer_region, bytes);
+    if (writer.Create(total_items) != Ok) return 1;
+    for (size_t i = 0; i < num_before; i++) {
+        if (writer.Add(i) != Ok) return 1;
+    }
+
+    // the reader checks the first half again and again while the writer adds
+    // the rest, which kicks many of them around
+    pid_t pid = fork();
+    if (pid == 0) {
+        Filter reader(reader_region, bytes);
+        if (reader.Attach() != Ok) _exit(2);
+        size_t misses = 0;
+        size_t passes = 0;
+        for (; done->load(std::memory_order_acquire) == 0 || passes == 0; passes++) {
+            for (size_t i = 0; i < num_before; i++) {
+                misses += reader.Contain(i) != Ok;
+            }
+        }
+        for (size_t i = 0; i < num_after; i++) {
+            misses += reader.Contain(i) != Ok;
+        }
+        std::cout << "reader: " << passes << " passes while adding, " << misses << " misses" << std::endl;
+        _exit(misses == 0 && reader.Size() == num_after ? 0 : 1);
+    }
+    // and then deletes and adds them back a few times, so the reader
+    // overlaps many writes
+    for (size_t round = 0; round < 20; round++) {
+        for (size_t i = num_before; i < num_after; i++) {
+            if (round > 0 && writer.Delete(i) != Ok) return 1;
+            if (writer.Add(i) != Ok) return 1;
+        }
+    }
+    done->store(1, std::memory_order_release);
+    int wstatus;
+    bool read_ok = pid > 0 && waitpid(pid, &wstatus, 0) == pid && WIFEXITED(wstatus) &&
+                   WEXITSTATUS(wstatus) == 0;
+    assert(read_ok);
+
+    // another type of filter does not attach
+    {
+        SharedCuckooFilter<uint64_t, 8, 4> other(reader_region, bytes);
+        assert(other.Attach() == NotSupported);
+    }
+
+    // a writer killed inside Add leaves the sequence odd; readers wait for it
+    // a while, then report IOError and the count as of the crash
+    ((SharedFilterHeader*) writer_region)->sequence.fetch_add(1);
+    Filter reader(reader_region, bytes);
+    if (reader.Attach() != Ok) return 1;
+    Status status = reader.Contain(0);
+    std::cout << "after a crashed write Contain returns " << status << ", Size "
+              << reader.Size() << "\n";
+    assert(status == IOError);
+    assert(reader.Size() == num_after);
+
+    munmap(writer_region, bytes);
+    munmap(reader_region, bytes);
+    close(fd);
+    return read_ok && status == IOError ? 0 : 1;
+}
@@ -0,0 +1,36 @@
+// Picks the filter configuration for a key count and a target false positive rate.
+// usage: tuner <expected_keys> <target_fpr> [memory_cap_bytes] [latency_goal_ns]
+#include "tuner.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using d_ary_cuckoofilter::Tuner;
+using d_ary_cuckoofilter::TunerOptions;
+using d_ary_cuckoofilter::TunedConfig;
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0]
+                  << " <expected_keys> <target_fpr> [memory_cap_bytes] [latency_goal_ns]\n";
+        return 1;
+    }
+
+    TunerOptions opts;
+    opts.expected_keys = strtoull(argv[1], NULL, 10);
+    opts.target_fpr = atof(argv[2]);
+    if (argc > 3) opts.memory_cap_bytes = strtoull(argv[3], NULL, 10);
+    if (argc > 4) opts.latency_goal_ns = atof(argv[4]);
+
+    std::vector<TunedConfig> configs = Tuner::Evaluate(opts);
+    for (size_t i = 0; i < configs.size(); i++) {
+        std::cout << (configs[i].feasible ? "[ok] " : "[--] ") << configs[i].Info();
+    }
+
+    TunedConfig best = Tuner::Pick(opts, configs);
+    std::cout << "\nBest configuration"
+              << (best.feasible ? "" : " (no configuration meets the options)") << ":\n"
+              << best.Info();
+    return best.feasible ? 0 : 2;
+}
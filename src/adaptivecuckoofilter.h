@@ -0,0 +1,332 @@
+// AdaptiveCuckooFilter is a d-ary Cuckoo filter that can remove false positives
+// once they are reported. Every slot has a selector bit choosing which of two
+// fingerprints of its item is stored. The keys of the stored items live in a
+// RemoteKeyMap provided by the caller, so when a query turns out to be a false
+// positive the colliding slots are re-encoded with the other fingerprint.
+#ifndef _ADAPTIVE_CUCKOO_FILTER_H_
+#define _ADAPTIVE_CUCKOO_FILTER_H_
+
+#include "d_ary_cuckoofilter.h"
+
+#include <vector>
+
+namespace d_ary_cuckoofilter {
+
+    // Keys of the items of an AdaptiveCuckooFilter by slot, kept outside of the
+    // filter, e.g. next to a backing store. Contain never reads it.
+    template <typename ItemType>
+    class RemoteKeyMap {
+    public:
+        virtual ~RemoteKeyMap() {}
+
+        // called once with the number of slots of the filter
+        virtual void Resize(size_t num_slots) = 0;
+
+        virtual ItemType Get(size_t slot) const = 0;
+
+        virtual void Put(size_t slot, const ItemType& item) = 0;
+    };
+
+    // RemoteKeyMap in local memory
+    template <typename ItemType>
+    class VectorKeyMap : public RemoteKeyMap<ItemType> {
+        std::vector<ItemType> keys_;
+
+    public:
+        void Resize(size_t num_slots) { keys_.resize(num_slots); }
+
+        ItemType Get(size_t slot) const { return keys_[slot]; }
+
+        void Put(size_t slot, const ItemType& item) { keys_[slot] = item; }
+    };
+
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets>
+    class AdaptiveCuckooFilter {
+        static_assert(num_candidate_buckets >= 2 && num_candidate_buckets <= 8,
+                      "num_candidate_buckets must be 2 to 8");
+
+        typedef DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, SingleTable> Filter;
+        typedef CuckooWalk<bits_per_item, num_candidate_buckets> Walk;
+
+        // Storage of fingerprints
+        SingleTable<bits_per_item> *table_;
+
+        // Number of items stored
+        size_t num_items_;
+
+        TableGeometry geometry_;
+
+        // one selector bit per slot, set if the slot holds the second fingerprint
+        std::vector<uint64_t> selectors_;
+
+        // keys by slot, not owned; without it nothing can be adapted
+        RemoteKeyMap<ItemType> *keys_;
+
+        typedef struct {
+            size_t index;
+            uint32_t tag;
+            bool used;
+            ItemType key;
+        } VictimCache;
+
+        VictimCache victim_;
+
+        // state of the random walk of Add
+        unsigned int seed_;
+
+        // number of slots re-encoded so far
+        size_t num_adapted_;
+
+        // the low 32 bits of a hash pick the tag that places the item and is
+        // stored while its selector is clear, the others the index
+        inline void SplitHash(const uint64_t hv, size_t* index, uint32_t* tag) const {
+            Walk::SplitHash(geometry_, hv, index, tag);
+        }
+
+        // the fingerprint stored while the selector is set, mixing all 64 bits
+        static inline uint32_t AltTag(const uint64_t hv) {
+            return Walk::TagHash((uint32_t) ((hv * 0x9E3779B97F4A7C15ULL) >> 32));
+        }
+
+        inline bool Selector(const size_t i) const {
+            return (selectors_[i >> 6] >> (i & 63)) & 1;
+        }
+
+        inline void SetSelector(const size_t i, const bool s) {
+            if (s) {
+                selectors_[i >> 6] |= 1ULL << (i & 63);
+            } else {
+                selectors_[i >> 6] &= ~(1ULL << (i & 63));
+            }
+        }
+
+        // the fingerprint an item hashing to hv has in slot i
+        inline uint32_t SlotTag(const size_t i, const uint64_t hv, const uint32_t tag) const {
+            return Selector(i) ? AltTag(hv) : tag;
+        }
+
+        inline void Candidates(const size_t i, const uint32_t tag,
+                               size_t (&index)[num_candidate_buckets]) const {
+            Walk::Candidates(geometry_, i, tag, index);
+        }
+
+        inline bool VictimMatch(const uint32_t tag,
+                                const size_t (&index)[num_candidate_buckets]) const {
+            return victim_.used && tag == victim_.tag && Walk::Among(victim_.index, index);
+        }
+
+        inline void Store(const size_t i, const uint32_t tag, const ItemType& key) {
+            table_->WriteTag(i, tag);
+            SetSelector(i, false);
+            if (keys_) keys_->Put(i, key);
+        }
+
+        // the placing tag and key of the item in slot i
+        inline void Load(const size_t i, uint32_t* tag, ItemType* key) const {
+            if (keys_) *key = keys_->Get(i);
+            if (Selector(i)) {
+                // selectors are only set with a key map
+                size_t unused;
+                SplitHash(Filter::Hash(*key), &unused, tag);
+            } else {
+                *tag = table_->ReadTag(i);
+            }
+        }
+
+        // slots for CuckooWalk; an evicted item moves with its key and gets its
+        // selector cleared
+        struct KeySlots {
+            struct Entry {
+                uint32_t tag;
+                ItemType key;
+            };
+
+            AdaptiveCuckooFilter* filter;
+
+            explicit KeySlots(AdaptiveCuckooFilter* f): filter(f) {}
+
+            inline uint32_t Tag(const Entry& e) const { return e.tag; }
+
+            inline bool Insert(const size_t i, const Entry& e) {
+                if (filter->table_->ReadTag(i) != 0) return false;
+                filter->Store(i, e.tag, e.key);
+                return true;
+            }
+
+            inline bool Kick(const size_t i, const Entry& e, Entry* old) {
+                if (Insert(i, e)) return true;
+                old->key = e.key;
+                filter->Load(i, &old->tag, &old->key);
+                filter->Store(i, e.tag, e.key);
+                return false;
+            }
+
+            inline void Prefetch(const size_t i) const { filter->table_->PrefetchBucket(i); }
+        };
+
+        bool Place(const size_t i, const uint32_t tag, const ItemType& key);
+
+    public:
+        explicit AdaptiveCuckooFilter(const size_t max_num_keys,
+                                      RemoteKeyMap<ItemType>* keys = NULL):
+            num_items_(0), keys_(keys), seed_(time(NULL)), num_adapted_(0) {
+            table_ = new SingleTable<bits_per_item>(num_candidate_buckets, max_num_keys);
+            geometry_ = table_->Geometry();
+            selectors_.resize((table_->SizeInBuckets() + 63) / 64);
+            if (keys_) keys_->Resize(table_->SizeInBuckets());
+            victim_.used = false;
+        }
+
+        ~AdaptiveCuckooFilter() {
+            delete table_;
+        }
+
+        Status Add(const ItemType& item);
+
+        Status Contain(const ItemType& item) const;
+
+        Status Delete(const ItemType& item);
+
+        // Tell the filter that item, for which Contain returned Ok, is not a
+        // member. Every slot matching it that holds another key is switched to
+        // its other fingerprint. NotFound if nothing matched and NotSupported
+        // without a key map.
+        Status ReportFalsePositive(const ItemType& item);
+
+        size_t Size() const { return num_items_; }
+
+        size_t NumAdapted() const { return num_adapted_; }
+
+        double LoadFactor() const { return 1.0 * Size() / table_->SizeInBuckets(); }
+
+        // the selector bits count, the remote keys do not
+        size_t SizeInBits() const {
+            return table_->SizeInBytes() * 8 + table_->SizeInBuckets();
+        }
+
+        double BitsPerItem() const { return 1.0 * SizeInBits() / Size(); }
+    };
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    bool
+    AdaptiveCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Place(const size_t i, const uint32_t tag,
+                                                                               const ItemType& key) {
+        KeySlots slots(this);
+        typename KeySlots::Entry victim;
+        if (Walk::Place(geometry_, slots, i, typename KeySlots::Entry{tag, key}, &seed_,
+                        &victim_.index, &victim)) {
+            return true;
+        }
+        victim_.tag = victim.tag;
+        victim_.key = victim.key;
+        victim_.used = true;
+        return false;
+    }//Place
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    Status
+    AdaptiveCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Add(const ItemType& item) {
+        if (victim_.used) {
+            return NotEnoughSpace;
+        }
+        size_t i;
+        uint32_t tag;
+        SplitHash(Filter::Hash(item), &i, &tag);
+        // an item left over goes to the victim, which fails every later Add
+        if (Place(i, tag, item)) {
+            num_items_++;
+        }
+        return Ok;
+    }//Add
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    Status
+    AdaptiveCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Contain(const ItemType& item) const {
+        const uint64_t hv = Filter::Hash(item);
+        size_t i;
+        uint32_t tag;
+        SplitHash(hv, &i, &tag);
+        size_t index[num_candidate_buckets];
+        Candidates(i, tag, index);
+
+        for (size_t j = 0; j < num_candidate_buckets; j++) {
+            if (table_->ReadTag(index[j]) == SlotTag(index[j], hv, tag)) {
+                return Ok;
+            }
+        }
+        if (VictimMatch(tag, index)) {
+            return Ok;
+        }
+        return NotFound;
+    }//Contain
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    Status
+    AdaptiveCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Delete(const ItemType& item) {
+        const uint64_t hv = Filter::Hash(item);
+        size_t i;
+        uint32_t tag;
+        SplitHash(hv, &i, &tag);
+        size_t index[num_candidate_buckets];
+        Candidates(i, tag, index);
+
+        for (size_t j = 0; j < num_candidate_buckets; j++) {
+            if (table_->ReadTag(index[j]) != SlotTag(index[j], hv, tag)) continue;
+            // with keys at hand only the item itself is deleted
+            if (keys_ && Filter::Hash(keys_->Get(index[j])) != hv) continue;
+            table_->WriteTag(index[j], 0);
+            SetSelector(index[j], false);
+            num_items_--;
+            goto TryEliminateVictim;
+        }
+        if (VictimMatch(tag, index)) {
+            victim_.used = false;
+            return Ok;
+        }
+        return NotFound;
+    TryEliminateVictim:
+        if (victim_.used) {
+            victim_.used = false;
+            if (Place(victim_.index, victim_.tag, victim_.key)) {
+                num_items_++;
+            }
+        }
+        return Ok;
+    }//Delete
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    Status
+    AdaptiveCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::ReportFalsePositive(const ItemType& item) {
+        if (!keys_) {
+            return NotSupported;
+        }
+        const uint64_t hv = Filter::Hash(item);
+        size_t i;
+        uint32_t tag;
+        SplitHash(hv, &i, &tag);
+        size_t index[num_candidate_buckets];
+        Candidates(i, tag, index);
+
+        bool adapted = false;
+        for (size_t j = 0; j < num_candidate_buckets; j++) {
+            const size_t k = index[j];
+            if (table_->ReadTag(k) != SlotTag(k, hv, tag)) continue;
+            const uint64_t stored = Filter::Hash(keys_->Get(k));
+            if (stored == hv) continue;
+            // the stored item keeps its slot, only its fingerprint changes
+            const bool s = !Selector(k);
+            size_t unused;
+            uint32_t stored_tag;
+            SplitHash(stored, &unused, &stored_tag);
+            table_->WriteTag(k, s ? AltTag(stored) : stored_tag);
+            SetSelector(k, s);
+            num_adapted_++;
+            adapted = true;
+        }
+        return adapted ? Ok : NotFound;
+    }//ReportFalsePositive
+}  // namespace d_ary_cuckoofilter
+
+#endif // #ifndef _ADAPTIVE_CUCKOO_FILTER_H_
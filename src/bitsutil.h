@@ -1,17 +1,20 @@
 /* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*- */
 #ifndef _BITS_H_
 #define _BITS_H_
-#define MAX 15
 
 #include <stdio.h>
 #include <iostream>
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <type_traits>
+#include <utility>
+
+#include "geometry.h"
 
 namespace d_ary_cuckoofilter {
     
-    inline uint64_t upperpower2(uint64_t x) {
+    constexpr uint64_t upperpower2(uint64_t x) {
         x--;
         x |= x >> 1;
         x |= x >> 2;
@@ -23,19 +26,58 @@ namespace d_ary_cuckoofilter {
         return x;
     }
     
-    inline uint64_t upperpower3(uint64_t x)
+    constexpr uint64_t upperpower3(uint64_t x)
     {
-        return (uint64_t)pow(3, ceil(log(x)/log(3)));
+        return upperpower(x, 3);
     }
     
-    inline uint64_t upperpower4(uint64_t x)
+    constexpr uint64_t upperpower4(uint64_t x)
     {
-        return (uint64_t)pow(4, ceil(log(x)/log(4)));
+        return upperpower(x, 4);
     }
     
-    inline uint64_t upperpower5(uint64_t x)
+    constexpr uint64_t upperpower5(uint64_t x)
     {
-        return (uint64_t)pow(5, ceil(log(x)/log(5)));
+        return upperpower(x, 5);
+    }
+    
+    // f(0), ..., f(n-1) with the argument an std::integral_constant, fully
+    // unrolled for loops over the candidate buckets. constexpr so a compile-time
+    // check can run them.
+    template <typename F, size_t... j>
+    constexpr void unrolled(F&& f, std::index_sequence<j...>) {
+        (f(std::integral_constant<size_t, j>()), ...);
+    }
+    
+    template <size_t n, typename F>
+    constexpr void unrolled(F&& f) {
+        unrolled(f, std::make_index_sequence<n>());
+    }
+    
+    // f(0) || ... || f(n-1), fully unrolled, stopping at the first true
+    template <typename F, size_t... j>
+    constexpr bool unrolledany(F&& f, std::index_sequence<j...>) {
+        return (f(std::integral_constant<size_t, j>()) || ...);
+    }
+    
+    template <size_t n, typename F>
+    constexpr bool unrolledany(F&& f) {
+        return unrolledany(f, std::make_index_sequence<n>());
+    }
+    
+    // maximum load factor a table with one slot per bucket sustains for a given
+    // number of candidate buckets; a table is sized so it never exceeds this
+    inline double loadthreshold(size_t num_candidate_buckets) {
+        switch (num_candidate_buckets) {
+            case 2: return 0.42;
+            case 3: return 0.91;
+            case 4: return 0.97;
+            case 5: return 0.985;
+            case 6: return 0.987;
+            case 7: return 0.99;
+            case 8: return 0.99;
+        }
+        return 1.0;
     }
     
     static const char* tbl[] =
@@ -63,36 +105,10 @@ namespace d_ary_cuckoofilter {
         std::cout << "fingerprint:" << t << std::endl;
     }
     
-    inline void base10toX(size_t a[], size_t t, size_t x) {
-        size_t m = t;
-        size_t i = 0;
-        while(t)
-        {
-            t/=x;
-            a[i++]=m-x*t;
-            m=t;
-        }
-    }
-    
-    inline size_t baseXto10(size_t a[], size_t x) {
-        size_t base10 = 0;
-        for( size_t i = 0; i < MAX; i++ ) {
-            base10 = a[i]*pow(x, i) + base10;
-        }
-        return base10;
-    }
-    
+    // digit-wise base-ary addition of fingerprint and index
     inline size_t xor_(size_t fingerprint, size_t index, size_t base) {
-        size_t a[MAX], b[MAX], result[MAX];
-        memset(a, 0, sizeof(a));
-        memset(b, 0, sizeof(b));
-        memset(result, 0, sizeof(result));
-        base10toX(a, fingerprint, base);
-        base10toX(b, index, base);
-        for (size_t i = 0; i < MAX; i++) {
-            result[i] = (a[i] + b[i]) % base;
-        }
-        return baseXto10(result, base);
+        size_t digits = numdigits(fingerprint > index ? fingerprint + 1 : index + 1, base);
+        return digitadd(fingerprint, index, digits, base);
     }
     
     inline size_t markbits(size_t t) {
@@ -0,0 +1,191 @@
+// CompactPackedTable is PackedTable with every slot packed into
+// bits_per_tag + markbits(d) bits, tag in the low bits and mark above it,
+// instead of two 32-bit words
+#ifndef _COMPACT_PACKED_TABLE_H_
+#define _COMPACT_PACKED_TABLE_H_
+
+#include <sstream>
+#include <string.h>
+#include <xmmintrin.h>
+#include <assert.h>
+
+#include "bitsutil.h"
+#include "dirtypages.h"
+#include "debug.h"
+#include "packedtable.h"
+
+
+namespace d_ary_cuckoofilter {
+
+    template <size_t bits_per_tag> //any size is OK
+    class CompactPackedTable {
+
+        static_assert(bits_per_tag >= 1 && bits_per_tag <= 32,
+                      "CompactPackedTable stores tags of 1 to 32 bits");
+
+        // a slot is read with one unaligned 64-bit load, the array is padded so
+        // the load of the last slot stays inside it
+        static const size_t kPadding = sizeof(uint64_t);
+
+        size_t num_buckets;
+        size_t mocktablesize;
+        size_t num_candidate_buckets;
+
+        // width of a slot and mask of its bits
+        size_t slot_bits_;
+        uint64_t slot_mask_;
+
+        // the whole mock table is a single block
+        TableGeometry geometry_;
+
+        unsigned char *bytes_;
+
+        // pages written since the last delta, NULL unless tracking is enabled
+        DirtyPages *dirty_;
+
+        inline uint64_t ReadSlot(const size_t s) const {
+            const size_t pos = s * slot_bits_;
+            uint64_t word;
+            memcpy(&word, bytes_ + (pos >> 3), sizeof(word));
+            return (word >> (pos & 7)) & slot_mask_;
+        }
+
+        inline void WriteSlot(const size_t s, const uint64_t v) {
+            const size_t pos = s * slot_bits_;
+            uint64_t word;
+            memcpy(&word, bytes_ + (pos >> 3), sizeof(word));
+            word &= ~(slot_mask_ << (pos & 7));
+            word |= v << (pos & 7);
+            memcpy(bytes_ + (pos >> 3), &word, sizeof(word));
+            if (dirty_) {
+                // a slot may straddle two pages
+                dirty_->Mark(pos >> 3);
+                dirty_->Mark((pos + slot_bits_ - 1) >> 3);
+            }
+        }
+
+    public:
+        static const uint32_t TAGMASK = (1ULL << bits_per_tag) - 1;
+
+        static double LoadThreshold(size_t num_candidate_buckets) {
+            return PackedTable<bits_per_tag>::LoadThreshold(num_candidate_buckets);
+        }
+
+        // number of buckets allocated for max_num_keys items
+        static size_t NumBuckets(size_t num_candidate_buckets, size_t max_num_keys) {
+            return ceil(max_num_keys / LoadThreshold(num_candidate_buckets));
+        }
+
+        explicit
+        CompactPackedTable(size_t num, size_t max_num_keys) {
+
+            num_candidate_buckets = num;
+
+            if (num_candidate_buckets < 2 || num_candidate_buckets > 8) {
+                std::cout << "the valid candidate bucket num is 2~8";
+            }
+            mocktablesize = upperpower(max_num_keys, num_candidate_buckets);
+            geometry_ = TableGeometry(num_candidate_buckets, mocktablesize, 1);
+            num_buckets = NumBuckets(num_candidate_buckets, max_num_keys);
+            slot_bits_ = bits_per_tag + markbits(num_candidate_buckets);
+            slot_mask_ = (1ULL << slot_bits_) - 1;
+            bytes_ = new unsigned char[SizeInBytes() + kPadding];
+            dirty_ = NULL;
+            CleanupTags();
+        }
+
+        ~CompactPackedTable() {
+            delete [] bytes_;
+            delete dirty_;
+        }
+
+        void CleanupTags() { memset(bytes_, 0, SizeInBytes() + kPadding); }
+
+        size_t SizeInBytes() const { return (num_buckets * slot_bits_ + 7) / 8; }
+
+        size_t SizeInBuckets() const { return num_buckets; }
+
+        // the table as raw bytes, for snapshots and deltas
+        char* RawBytes() { return (char*) bytes_; }
+
+        const char* RawBytes() const { return (const char*) bytes_; }
+
+        // start recording written pages, all pages clean
+        void EnableDirtyTracking() {
+            if (!dirty_) dirty_ = new DirtyPages(SizeInBytes());
+        }
+
+        DirtyPages* Dirty() { return dirty_; }
+
+        size_t HashTableSize() const { return mocktablesize; }
+
+        // candidates are computed over the whole power-of-d mock table
+        size_t BlockSize() const { return mocktablesize; }
+
+        const TableGeometry& Geometry() const { return geometry_; }
+
+        std::string Info() const  {
+            std::stringstream ss;
+            ss << "\t\tCompactPackedHashTable with tag size: " << bits_per_tag << " bits \n";
+            ss << "\t\tCompactPackedHashTable with mark size: " << markbits(num_candidate_buckets) << " bits \n";
+            ss << "\t\tTotal rows: " << num_buckets << "\n";
+            ss << "\t\tTable size in bits: " << SizeInBuckets() * slot_bits_ << "\n";
+            return ss.str();
+        }
+
+
+        inline uint32_t ReadTag(const size_t i) const {
+            return ReadSlot(i % num_buckets) & TAGMASK;
+        }
+
+        inline uint32_t ReadMark(const size_t i) const {
+            return ReadSlot(i % num_buckets) >> bits_per_tag;
+        }
+
+
+        inline void  WriteTag(const size_t i, const uint32_t t) {
+            WriteSlot(i % num_buckets, (t & TAGMASK) | ((uint64_t) (i / num_buckets) << bits_per_tag));
+        }
+
+        inline void PrefetchBucket(const size_t i) const {
+            _mm_prefetch((const char*) bytes_ + (i % num_buckets) * slot_bits_ / 8, _MM_HINT_T0);
+        }
+
+        // index the tag stored in slot i was placed under, recovered from its mark
+        inline size_t IndexOfSlot(const size_t i) const {
+            return i + ReadMark(i) * num_buckets;
+        }
+
+        // tag and mark are compared at once
+        inline bool  FindTagInBucket(const size_t i,  const uint32_t tag) const {
+            return ReadSlot(i % num_buckets) == (tag | ((uint64_t) (i / num_buckets) << bits_per_tag));
+        }// FindTagInBucket
+
+        inline  bool  DeleteTagFromBucket(const size_t i,  const uint32_t tag) {
+            if (FindTagInBucket(i, tag)) {
+                WriteTag(i, 0);
+                return true;
+            }
+            return false;
+        }// DeleteTagFromBucket
+
+        inline  bool  InsertTagToBucket(size_t&  i,  const uint32_t tag,
+                                        const bool kickout, uint32_t& oldtag) {
+            const uint64_t slot = ReadSlot(i % num_buckets);
+            if ((slot & TAGMASK) == 0) {
+                WriteTag(i, tag);
+                return true;
+            }
+            if (kickout) {
+                size_t mark = slot >> bits_per_tag;
+                oldtag = slot & TAGMASK;
+                WriteTag(i, tag);
+                i = i%num_buckets + mark * num_buckets;
+            }
+            return false;
+        }// InsertTagToBucket
+
+    };// CompactPackedTable
+}
+
+#endif // #ifndef _COMPACT_PACKED_TABLE_H_
@@ -0,0 +1,165 @@
+// CuckooWalk holds what every d-ary filter of this library does alike: split a
+// hash into index and tag, list the candidates of a tag, and place a tag along
+// a random walk of kicks. Filters differ only in what moves with a tag, e.g. a
+// value, a key or a generation; they pass a Slots policy for that:
+//
+//     typedef ... Entry;                    // what one slot holds
+//     uint32_t Tag(const Entry& e) const;   // the tag that places e
+//     bool Insert(size_t i, const Entry& e);
+//                                           // store e if slot i is empty
+//     bool Kick(size_t& i, const Entry& e, Entry* old);
+//                                           // store e in slot i; true if it was
+//                                           // empty, else its entry goes to old.
+//                                           // i may be rewritten, as by
+//                                           // InsertTagToBucket of tables with marks
+//     void Prefetch(size_t i) const;
+#ifndef _CUCKOO_WALK_H_
+#define _CUCKOO_WALK_H_
+
+#include "bitsutil.h"
+#include "hashutil.h"
+
+#include <stdlib.h>
+#include <cassert>
+
+namespace d_ary_cuckoofilter {
+
+    // maximum number of cuckoo kicks before claiming failure
+    const size_t kMaxCuckooCount = 5000;
+
+    // hash of a tag giving the offset between its candidates, 64 bits wide for
+    // blocks of more than 2^32 buckets
+    inline uint64_t offsethash(const uint32_t tag, const size_t block_size) {
+        if (block_size <= (1ULL << 32)) return HashUtil::BobHash((const void*) (&tag), 4);
+        uint32_t low = 0, high = 0;
+        HashUtil::BobHash((const void*) (&tag), 4, &low, &high);
+        return ((uint64_t) high << 32) | low;
+    }
+
+    // Slots over a table with InsertTagToBucket, holding bare tags
+    template <typename TableType>
+    struct TagSlots {
+        typedef uint32_t Entry;
+
+        TableType* table;
+
+        explicit TagSlots(TableType* t): table(t) {}
+
+        inline uint32_t Tag(const Entry& e) const { return e; }
+
+        inline bool Insert(size_t i, const Entry& e) {
+            uint32_t unused = 0;
+            return table->InsertTagToBucket(i, e, false, unused);
+        }
+
+        inline bool Kick(size_t& i, const Entry& e, Entry* old) {
+            return table->InsertTagToBucket(i, e, true, *old);
+        }
+
+        inline void Prefetch(const size_t i) const { table->PrefetchBucket(i); }
+    };
+
+    template <size_t bits_per_item,
+    size_t num_candidate_buckets>
+    struct CuckooWalk {
+        static_assert(num_candidate_buckets >= 2 && num_candidate_buckets <= 8,
+                      "num_candidate_buckets must be 2 to 8");
+
+        static inline uint32_t TagHash(uint32_t hv) {
+            uint32_t tag;
+            tag = hv & ((1ULL << bits_per_item) - 1);
+            tag += (tag == 0);
+            return tag;
+        }
+
+        // the low 32 bits of a hash pick the tag, the others the index, see
+        // TableGeometry::Index
+        static inline void SplitHash(const TableGeometry& geometry, const uint64_t hv,
+                                     size_t* index, uint32_t* tag) {
+            *index = geometry.Index(hv);
+            *tag   = TagHash((uint32_t) (hv & 0xFFFFFFFF));
+        }
+
+        // all candidates of tag starting from index[0] = i, hashing the tag once
+        static inline void Candidates(const TableGeometry& geometry, const size_t i, const uint32_t tag,
+                                      size_t (&index)[num_candidate_buckets]) {
+            const uint64_t hv = offsethash(tag, geometry.block_size);
+            index[0] = i;
+            unrolled<num_candidate_buckets - 1>([&](auto j) {
+                index[j + 1] = geometry.AltIndex<num_candidate_buckets>(index[j], hv);
+            });
+            assert(index[0] == geometry.AltIndex<num_candidate_buckets>(
+                index[num_candidate_buckets-1], hv));
+        }
+
+        // true if k is one of the candidates in index, e.g. the index of a victim
+        static inline bool Among(const size_t k, const size_t (&index)[num_candidate_buckets]) {
+            return unrolledany<num_candidate_buckets>([&](auto j) {
+                return index[j] == k;
+            });
+        }
+
+        // One kick: put entry in slot pos, then try the other candidates of the
+        // tag it evicts. Those are computed and prefetched before any of them
+        // is probed, so their loads overlap. True if everything found a slot;
+        // else entry is the evicted one and pos a random other candidate of it
+        // to kick next.
+        template <typename Slots>
+        static bool Kick(const TableGeometry& geometry, Slots& slots, size_t* pos,
+                         typename Slots::Entry* entry, unsigned int* seed) {
+            typename Slots::Entry old;
+            if (slots.Kick(*pos, *entry, &old)) {
+                return true;
+            }
+            *entry = old;
+
+            const uint64_t hv = offsethash(slots.Tag(*entry), geometry.block_size);
+            size_t next[num_candidate_buckets - 1];
+            size_t at = *pos;
+            unrolled<num_candidate_buckets - 1>([&](auto j) {
+                at = geometry.AltIndex<num_candidate_buckets>(at, hv);
+                next[j] = at;
+                slots.Prefetch(at);
+            });
+            if (unrolledany<num_candidate_buckets - 1>([&](auto j) {
+                    return slots.Insert(next[j], *entry);
+                })) {
+                return true;
+            }
+            *pos = next[rand_r(seed) % (num_candidate_buckets - 1)];
+            return false;
+        }
+
+        // Place entry, whose index is i, kicking out other entries along a random
+        // walk. Only slots are modified, so callers working on disjoint blocks may
+        // run concurrently. Returns false with the entry left over in victim,
+        // and victim_index one of its candidates.
+        template <typename Slots>
+        static bool Place(const TableGeometry& geometry, Slots& slots, const size_t i,
+                          const typename Slots::Entry& entry, unsigned int* seed,
+                          size_t* victim_index, typename Slots::Entry* victim) {
+            size_t index[num_candidate_buckets];
+            Candidates(geometry, i, slots.Tag(entry), index);
+            if (unrolledany<num_candidate_buckets>([&](auto j) {
+                    return slots.Insert(index[j], entry);
+                })) {
+                return true;
+            }
+
+            // we use ramdom walk strategy
+            size_t pos = index[rand_r(seed) % num_candidate_buckets];
+            typename Slots::Entry current = entry;
+            for (uint32_t count = 0; count < kMaxCuckooCount; count++) {
+                if (Kick(geometry, slots, &pos, &current, seed)) {
+                    return true;
+                }
+            }
+
+            *victim_index = pos;
+            *victim = current;
+            return false;
+        }
+    };
+}
+
+#endif // #ifndef _CUCKOO_WALK_H_
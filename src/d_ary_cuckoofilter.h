@@ -1,15 +1,25 @@
 #ifndef _CUCKOO_FILTER_H_
 #define _CUCKOO_FILTER_H_
 
+#include "cuckoowalk.h"
 #include "debug.h"
+#include "deferredqueue.h"
+#include "delta.h"
 #include "hashutil.h"
+#include "hotness.h"
+#include "keytraits.h"
 #include "singletable.h"
 #include "mocktable.h"
 #include "packedtable.h"
+#include "compactpackedtable.h"
 
 #include <stdlib.h>
+#include <time.h>
+#include <algorithm>
 #include <cassert>
+#include <thread>
 #include <typeinfo>
+#include <vector>
 
 namespace d_ary_cuckoofilter {
     // status returned
@@ -18,30 +28,48 @@ namespace d_ary_cuckoofilter {
         NotFound = 1,
         NotEnoughSpace = 2,
         NotSupported = 3,
+        IOError = 4,
     };
     
-    // maximum number of cuckoo kicks before claiming failure
-    const size_t kMaxCuckooCount = 5000;
+    // number of items a batched operation prefetches ahead of the probes
+    const size_t kBatchWindow = 16;
+    
+    // number of slots a scan prefetches ahead of the slot it reads
+    const size_t kScanAhead = 512;
+    
+    // default number of items waiting for the worker of deferred inserts
+    const size_t kDeferredCapacity = 64;
+    
+    // kicks the worker of deferred inserts runs each time it takes the lock
+    const size_t kDeferredKicks = 8;
     
     // DaryCuckooFilter provides methods of Add, Delete, Contain.
     // DaryCuckoofilter takes four template parameters:
     // ItemType, bits_per_item, num_candidate_buckets and TableType
-    // ItemType is the type of item you want to insert
+    // ItemType is the type of item you want to insert, see KeyTraits for how it is hashed
     // bits_per_item is the number of bits each item is hashed into
     // num_candidate_buckets is hte number of possible location each item can go
-    // TableType is the storage of table, SingleTable by default, MockTable and PackedTable are for
-    // experimental usage
+    // TableType is the storage of table, SingleTable by default, MockTable, PackedTable and
+    // CompactPackedTable are for experimental usage
     template <typename ItemType,
     size_t bits_per_item,
     size_t num_candidate_buckets,
     template<size_t> class TableType>
     class DaryCuckooFilter {
+        static_assert(num_candidate_buckets >= 2 && num_candidate_buckets <= 8,
+                      "num_candidate_buckets must be 2 to 8");
+        
+        typedef CuckooWalk<bits_per_item, num_candidate_buckets> Walk;
+        
         // Storage of items
         TableType<bits_per_item> *table_;
         
         // Number of items stored
         size_t  num_items_;
         
+        // block layout of table_, copied once at construction
+        TableGeometry geometry_;
+        
         typedef struct {
             size_t index;
             uint32_t tag;
@@ -50,41 +78,121 @@ namespace d_ary_cuckoofilter {
         
         VictimCache victim_;
         
-        inline size_t IndexHash(uint32_t hv) const {
-            return hv % table_->HashTableSize();
-        }
+        // state of the random walk of AddImpl
+        unsigned int seed_;
         
-        inline uint32_t TagHash(uint32_t hv) const {
-            uint32_t tag;
-            tag = hv & ((1ULL << bits_per_item) - 1);
-            tag += (tag == 0);
-            return tag;
+        // number of the last delta exported or applied
+        uint64_t delta_version_;
+        
+        // lookups that hit past the first candidate, NULL unless tracking is enabled
+        HotnessSketch *hot_;
+        
+        // items waiting to be kicked into the table, NULL unless deferred
+        // inserts are enabled
+        DeferredQueue *deferred_;
+        
+        inline void SplitHash(const uint64_t hv,
+                              size_t* index,
+                              uint32_t* tag) const {
+            Walk::SplitHash(geometry_, hv, index, tag);
         }
         
         inline void GenerateIndexTagHash(const ItemType &item,
                                          size_t* index,
                                          uint32_t* tag) const {
-            
-            std::string hashed_key = HashUtil::SHA1Hash((const char*) &item,
-                                                        sizeof(item));
-            uint64_t hv = *((uint64_t*) hashed_key.c_str());
-            
-            *index = IndexHash((uint32_t) (hv >> 32));
-            *tag   = TagHash((uint32_t) (hv & 0xFFFFFFFF));
+            SplitHash(Hash(item), index, tag);
         }
         
+        // the candidates of an item are the index plus multiples of a tag-derived
+        // offset, see TableGeometry
         inline size_t AltIndex(const size_t index, const uint32_t tag) const {
-            switch (num_candidate_buckets) {
-                case 2: return index ^ IndexHash(HashUtil::BobHash((const void*) (&tag), 4));
-                case 3: return xor_(IndexHash(HashUtil::BobHash((const void*) (&tag), 4)) , index, 3);
-                case 4: return xor_(IndexHash(HashUtil::BobHash((const void*) (&tag), 4)) , index, 4);
-                case 5: return xor_(IndexHash(HashUtil::BobHash((const void*) (&tag), 4)) , index, 5);
-            }
-            
+            return geometry_.AltIndex<num_candidate_buckets>(
+                index, offsethash(tag, geometry_.block_size));
+        }
+        
+        inline void Candidates(const size_t i, const uint32_t tag,
+                               size_t (&index)[num_candidate_buckets]) const {
+            Walk::Candidates(geometry_, i, tag, index);
+        }
+        
+        // true if the victim holds tag under one of the candidates in index
+        inline bool VictimMatch(const uint32_t tag,
+                                const size_t (&index)[num_candidate_buckets]) const {
+            return victim_.used && tag == victim_.tag && Walk::Among(victim_.index, index);
+        }
+        
+        // Place tag, see CuckooWalk::Place. Returns false with the tag left over
+        // in victim_index/victim_tag.
+        bool PlaceTag(const size_t i, const uint32_t tag, unsigned int* seed,
+                      size_t* victim_index, uint32_t* victim_tag) {
+            TagSlots<TableType<bits_per_item> > slots(table_);
+            return Walk::Place(geometry_, slots, i, tag, seed, victim_index, victim_tag);
         }
         
         Status AddImpl(const size_t i, const uint32_t tag);
         
+        // place tag, leaving it in the victim if that fails
+        Status PlaceOrVictim(const size_t i, const uint32_t tag);
+        
+        // true if tag is in one of the candidates of index i or in the victim.
+        // record counts a hit past the first candidate for promotion; lookups
+        // of the caller do, internal ones like Intersect do not.
+        bool ContainImpl(const size_t i, const uint32_t tag, const bool record) const;
+        
+        bool ContainPlaced(const size_t i, const uint32_t tag, const bool record) const;
+        
+        // slot in deferred_->items of tag under one of the candidates of index
+        // i, deferred_->items.size() if there is none
+        size_t FindDeferred(const size_t i, const uint32_t tag) const;
+        
+        // one kick of the item last in deferred_->items
+        void KickDeferred();
+        
+        // the loop of the worker of deferred inserts
+        void DrainDeferred();
+        
+        Status DeleteImpl(const size_t i, const uint32_t tag);
+        
+        // filters can be merged only when their tables are laid out alike
+        bool SameGeometry(const DaryCuckooFilter& other) const {
+            return geometry_.num_buckets == other.geometry_.num_buckets &&
+                   geometry_.block_size == other.geometry_.block_size &&
+                   table_->HashTableSize() == other.table_->HashTableSize();
+        }
+        
+        // Placement is split into ranges of whole blocks, one per thread. Kicks
+        // never leave the block of an index, so threads owning different ranges
+        // never touch the same slot.
+        size_t NumBlockRanges(size_t num_threads) const {
+            if (table_->SizeInBuckets() != geometry_.num_buckets) {
+                // slots of a table with marks do not map to blocks
+                return 1;
+            }
+            return std::max((size_t) 1, std::min(num_threads, geometry_.num_blocks));
+        }
+        
+        // first slot of block range t
+        size_t BlockRangeBegin(size_t t, size_t num_ranges) const {
+            if (t == num_ranges) return table_->SizeInBuckets();
+            return geometry_.num_blocks * t / num_ranges * geometry_.block_size;
+        }
+        
+        // block range holding index i
+        size_t BlockRangeOf(size_t i, size_t num_ranges) const {
+            size_t t = i / geometry_.block_size * num_ranges / geometry_.num_blocks;
+            while (t + 1 < num_ranges && BlockRangeBegin(t + 1, num_ranges) <= i) t++;
+            while (t > 0 && BlockRangeBegin(t, num_ranges) > i) t--;
+            return t;
+        }
+        
+        // add the tags parallel placement could not fit through the serial path
+        Status AddLeftover(const std::vector<std::vector<VictimCache> >& leftover);
+        
+        // reinsert the tags of slots [begin, end) of other
+        void MergeRange(const DaryCuckooFilter& other, size_t begin, size_t end,
+                        unsigned int* seed, size_t* num_added,
+                        std::vector<VictimCache>* leftover);
+        
         // load factor is the fraction of occupancy
     public:
         double LoadFactor() const {
@@ -103,11 +211,18 @@ namespace d_ary_cuckoofilter {
         explicit DaryCuckooFilter(const size_t max_num_keys): num_items_(0) {
             
             victim_.used = false;
+            seed_ = (unsigned) time(NULL);
+            delta_version_ = 0;
+            hot_ = NULL;
+            deferred_ = NULL;
             table_  = new TableType<bits_per_item>(num_candidate_buckets, max_num_keys);
+            geometry_ = table_->Geometry();
         }
         
         ~DaryCuckooFilter() {
+            DisableDeferredInserts();
             delete table_;
+            delete hot_;
         }
         
         
@@ -120,15 +235,222 @@ namespace d_ary_cuckoofilter {
         // Delete an key from the filter
         Status Delete(const ItemType& item);
         
+        /* methods for callers that already own a 64-bit hash of their items. The
+         * hash is split into index and tag like the hash of an item, so it must
+         * be well mixed; one hash can feed several filters. */
+        // the hash Add, Contain and Delete use for an item
+        static uint64_t Hash(const ItemType& item) {
+            thread_local SHA1Stream h;
+            KeyTraits<ItemType>::Update(item, &h);
+            return h.Final64();
+        }
+        
+        Status AddHash(const uint64_t hv);
+        
+        Status ContainHash(const uint64_t hv) const;
+        
+        Status DeleteHash(const uint64_t hv);
+        
+        // batched forms, statuses[k] is the result for hvs[k]. Candidate buckets
+        // are prefetched kBatchWindow items ahead.
+        void AddHashBatch(const uint64_t* hvs, size_t n, Status* statuses);
+        
+        void ContainHashBatch(const uint64_t* hvs, size_t n, Status* statuses) const;
+        
+        void DeleteHashBatch(const uint64_t* hvs, size_t n, Status* statuses);
+        
+        /* methods for combining filters built over disjoint sets of keys. The
+         * filters must have the same template parameters and be constructed with
+         * the same max_num_keys, which is the capacity of the combined filter. */
+        // add every item of other to this filter
+        Status Merge(const DaryCuckooFilter& other);
+        
+        // keep only the items other reports as contained
+        Status Intersect(const DaryCuckooFilter& other);
+        
+        // k-way merge of shards into out, using num_threads threads over disjoint
+        // ranges of blocks of the table
+        static Status MergeShards(const std::vector<const DaryCuckooFilter*>& shards,
+                                  DaryCuckooFilter* out, size_t num_threads);
+        
+        // Add n items using num_threads threads. Keys are hashed in parallel, then
+        // grouped by block range and placed by one thread per range; the few that
+        // do not fit are added serially at the end.
+        Status ParallelBuild(const ItemType* keys, size_t n, size_t num_threads);
+        
+        // Count lookups that hit past the first candidate, see HotnessSketch.
+        // Contain, ContainHash, their batches and interleaved lookups count
+        // alike; internal lookups, e.g. of Intersect, do not. Lookups stay safe
+        // to run concurrently.
+        void EnableHotnessTracking(size_t width = 1 << 16, uint32_t sample_shift = 4) {
+            if (!hot_) hot_ = new HotnessSketch(width, sample_shift);
+        }
+        
+        // Maintenance for skewed lookups: move the items found hot since the last
+        // call to their first candidate, where Contain finds them with one probe,
+        // then age the counts. An item whose first candidate is taken moves only
+        // if the occupant can go to another of its own candidates. Must not run
+        // concurrently with other operations. Returns the number of items moved.
+        size_t PromoteHotItems();
+        
+        /* methods for bounding the latency of Add. With deferred inserts, Add
+         * only tries the candidates of an item; an item finding them all taken
+         * waits in a queue of up to capacity items, where Contain and Delete
+         * see it, until a worker thread has kicked it into the table. Add runs
+         * the kicks itself only when the queue is full. Add, Contain, Delete,
+         * their Hash and batched forms, interleaved lookups and Size may run
+         * on one thread next to the worker; everything else needs deferred
+         * inserts disabled. */
+        void EnableDeferredInserts(size_t capacity = kDeferredCapacity);
+        
+        // wait until the worker has placed every queued item, or the table is full
+        void FlushDeferred();
+        
+        // flush and stop the worker. Items still queued because the table is
+        // full are dropped.
+        void DisableDeferredInserts();
+        
+        // number of items queued
+        size_t NumDeferred() const {
+            if (!deferred_) return 0;
+            return deferred_->pending.load(std::memory_order_acquire);
+        }
+        
+        /* methods for replicating a filter with deltas */
+        // start recording changed pages; the first delta carries the whole table
+        void EnableDeltaTracking() {
+            table_->EnableDirtyTracking();
+            table_->Dirty()->MarkAll();
+        }
+        
+        // export the pages changed since the previous delta, the item count and
+        // the victim, and start a new delta
+        Status ExportDelta(FilterDelta* delta);
+        
+        // export the whole table as a delta with base_version 0 at the current
+        // version, e.g. for a replica that joins late or missed deltas. Neither
+        // tracking nor the next delta is affected.
+        void ExportSnapshot(FilterDelta* snapshot) const;
+        
+        // bring a replica up to date. Applying a delta twice, or one older than the
+        // replica, does nothing; a snapshot is applied at any version from the
+        // replica's on. Returns NotSupported if the table layout differs or
+        // deltas were missed since the replica's version.
+        Status ApplyDelta(const FilterDelta& delta);
+        
+        uint64_t DeltaVersion() const { return delta_version_; }
+        
+        // state of the random walk of Add. The same changes replayed on the same
+        // table from the same seed place every tag, and the victim, the same way.
+        unsigned int Seed() const { return seed_; }
+        
+        void SetSeed(const unsigned int seed) { seed_ = seed; }
+        
+        // Visit the occupied slots s in [begin, end) in order, calling
+        // visit(s, tag, mark). The tag was placed under index
+        // s + mark * SizeInBuckets(); mark is 0 unless the table has marks.
+        template <typename Visitor>
+        void ForEachSlot(size_t begin, size_t end, Visitor visit) const {
+            for (size_t s = begin; s < end; s++) {
+                if ((s & 15) == 0 && s + kScanAhead < end) {
+                    table_->PrefetchBucket(s + kScanAhead);
+                }
+                const uint32_t tag = table_->ReadTag(s);
+                if (tag == 0) continue;
+                visit(s, tag, table_->ReadMark(s));
+            }
+        }
+        
+        template <typename Visitor>
+        void ForEachSlot(Visitor visit) const {
+            ForEachSlot(0, table_->SizeInBuckets(), visit);
+        }
+        
+        // ForEachSlot over num_threads equal ranges of the table at once, calling
+        // visit(t, s, tag, mark) from thread t
+        template <typename Visitor>
+        void ParallelForEachSlot(size_t num_threads, Visitor visit) const {
+            const size_t n = table_->SizeInBuckets();
+            num_threads = std::max((size_t) 1, std::min(num_threads, n));
+            std::vector<std::thread> threads;
+            for (size_t t = 0; t < num_threads; t++) {
+                threads.push_back(std::thread([this, t, n, num_threads, &visit]() {
+                    ForEachSlot(n * t / num_threads, n * (t + 1) / num_threads,
+                                [&](size_t s, uint32_t tag, uint32_t mark) {
+                                    visit(t, s, tag, mark);
+                                });
+                }));
+            }
+            for (size_t t = 0; t < num_threads; t++) threads[t].join();
+        }
+        
+        /* methods for interleaved lookups. LookupBegin starts a lookup and
+         * prefetches its first candidate; every LookupStep probes the candidate
+         * prefetched last and, unless the lookup is decided, prefetches the next
+         * one. A scheduler can keep many lookups in flight this way, see
+         * InterleavedLookup. */
+        struct LookupState {
+            size_t index;
+            uint32_t tag;
+            uint64_t offset_hash;
+            // candidates probed so far
+            size_t step;
+            // the first candidate, where a hot item is promoted to
+            size_t first;
+        };
+        
+        void LookupBegin(const uint64_t hv, LookupState* state) const {
+            SplitHash(hv, &state->index, &state->tag);
+            state->first = state->index;
+            state->offset_hash = offsethash(state->tag, geometry_.block_size);
+            state->step = 0;
+            table_->PrefetchBucket(state->index);
+        }
+        
+        // true when the lookup is decided, with its result in status. While
+        // deferred items are queued a tag may move between steps, so a step
+        // then decides the whole lookup under the lock.
+        bool LookupStep(LookupState* state, Status* status) const {
+            if (__builtin_expect(deferred_ != NULL && deferred_->Busy(), 0)) {
+                *status = ContainImpl(state->first, state->tag, true) ? Ok : NotFound;
+                return true;
+            }
+            if (table_->FindTagInBucket(state->index, state->tag)) {
+                if (hot_ && state->step > 0) hot_->Record(state->first, state->tag);
+                *status = Ok;
+                return true;
+            }
+            if (victim_.used && state->tag == victim_.tag && state->index == victim_.index) {
+                *status = Ok;
+                return true;
+            }
+            if (++state->step == num_candidate_buckets) {
+                *status = NotFound;
+                return true;
+            }
+            state->index = geometry_.AltIndex<num_candidate_buckets>(state->index, state->offset_hash);
+            table_->PrefetchBucket(state->index);
+            return false;
+        }
+        
         /* methods for providing stats  */
         // summary infomation
         std::string Info() const;
         
-        // number of current inserted items;
-        size_t Size() const { return num_items_; }
+        // number of current inserted items, counting queued ones;
+        size_t Size() const {
+            if (__builtin_expect(deferred_ != NULL && deferred_->Busy(), 0)) {
+                std::lock_guard<std::mutex> lock(deferred_->mutex);
+                return num_items_;
+            }
+            return num_items_;
+        }
         
         // size of the filter in bytes.
         size_t SizeInBytes() const { return table_->SizeInBytes(); }
+        
+        // number of slots in the table
+        size_t SizeInBuckets() const { return table_->SizeInBuckets(); }
     };
     
     
@@ -136,14 +458,22 @@ namespace d_ary_cuckoofilter {
     template<size_t> class TableType>
     Status
     DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::Add(const ItemType& item) {
+        return AddHash(Hash(item));
+    }
+    
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    Status
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::AddHash(const uint64_t hv) {
         size_t i;
         uint32_t tag;
         
-        if (victim_.used) {
+        // with deferred inserts the worker sets the victim, AddImpl checks it
+        if (!deferred_ && victim_.used) {
             return NotEnoughSpace;
         }
         
-        GenerateIndexTagHash(item, &i, &tag);
+        SplitHash(hv, &i, &tag);
         return AddImpl(i, tag);
     }
     
@@ -151,137 +481,770 @@ namespace d_ary_cuckoofilter {
     template<size_t> class TableType>
     Status
     DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::AddImpl(const size_t i, const uint32_t tag) {
-        uint32_t curtag = tag;
-        uint32_t oldtag = 0;
-        size_t index[5]; //index[0] for curindex, index[1~4] for altindex
-        index[0] = i;
+        if (__builtin_expect(deferred_ == NULL, 1)) {
+            return PlaceOrVictim(i, tag);
+        }
         
-        srand((unsigned)time(NULL));
+        std::lock_guard<std::mutex> lock(deferred_->mutex);
+        // the worker may have filled the table since the caller looked
+        if (victim_.used) {
+            return NotEnoughSpace;
+        }
+        if (deferred_->items.size() >= deferred_->capacity) {
+            return PlaceOrVictim(i, tag);
+        }
+        size_t index[num_candidate_buckets];
+        Candidates(i, tag, index);
+        uint32_t unused = 0;
+        if (!unrolledany<num_candidate_buckets>([&](auto j) {
+                return table_->InsertTagToBucket(index[j], tag, false, unused);
+            })) {
+            deferred_->Push({i, tag, 0});
+            deferred_->work_cv.notify_one();
+        }
+        num_items_++;
+        return Ok;
+    }//AddImpl
+    
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    Status
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::PlaceOrVictim(const size_t i, const uint32_t tag) {
+        size_t victim_index;
+        uint32_t victim_tag;
         
-        for (size_t j =1; j<num_candidate_buckets; j++) {
-            index[j] = AltIndex(index[j-1], curtag);
+        if (PlaceTag(i, tag, &seed_, &victim_index, &victim_tag)) {
+            num_items_++;
+            return Ok;
         }
-        assert(index[0] == AltIndex(index[num_candidate_buckets-1], curtag));
         
-        bool kickout = false;
+        std::cout << "Not Enough Space" << std::endl;
+        victim_.index = victim_index;
+        victim_.tag = victim_tag;
+        victim_.used = true;
+        return Ok;
+    }//PlaceOrVictim
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    Status
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::Contain(const ItemType& key) const {
+        return ContainHash(Hash(key));
+    }
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    Status
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::ContainHash(const uint64_t hv) const {
+        size_t i;
+        uint32_t tag;
         
-        for (size_t j=0; j<num_candidate_buckets; j++) {
-            if (table_->InsertTagToBucket(index[j], curtag, kickout, oldtag)) {
-                num_items_++;
-                return Ok;
-            }
+        SplitHash(hv, &i, &tag);
+        return ContainImpl(i, tag, true) ? Ok : NotFound;
+    }
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    bool
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::ContainImpl(const size_t i, const uint32_t tag,
+                                                                                            const bool record) const {
+        if (__builtin_expect(deferred_ == NULL || !deferred_->Busy(), 1)) {
+            return ContainPlaced(i, tag, record);
         }
-        
-        // we use ramdom walk strategy
-        switch (rand() % num_candidate_buckets) {
-            case 0: break;
-            case 1: index[0] = index[1]; break;
-            case 2: index[0] = index[2]; break;
-            case 3: index[0] = index[3]; break;
-            case 4: index[0] = index[4]; break;
+        std::lock_guard<std::mutex> lock(deferred_->mutex);
+        return ContainPlaced(i, tag, record) || FindDeferred(i, tag) < deferred_->items.size();
+    }
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    inline bool
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::ContainPlaced(const size_t i, const uint32_t tag,
+                                                                                              const bool record) const {
+        // candidates are computed one at a time and probed right away, so an item
+        // found under its index costs no offset hash at all
+        if (table_->FindTagInBucket(i, tag)) {
+            return true;
         }
-
-        for (uint32_t count = 0; count < kMaxCuckooCount; count++) {
-            bool kickout = true;
-            oldtag = 0;
-            table_->InsertTagToBucket(index[0], curtag, kickout, oldtag);
-            curtag = oldtag;
+        const uint64_t hv = offsethash(tag, geometry_.block_size);
+        size_t index = i;
+        if (unrolledany<num_candidate_buckets - 1>([&](auto) {
+                index = geometry_.AltIndex<num_candidate_buckets>(index, hv);
+                return table_->FindTagInBucket(index, tag);
+            })) {
+            if (hot_ && record) hot_->Record(i, tag);
+            return true;
+        }
+        // the victim is only used once the table is full
+        if (__builtin_expect(victim_.used, 0)) {
+            size_t candidates[num_candidate_buckets];
+            Candidates(i, tag, candidates);
+            return VictimMatch(tag, candidates);
+        }
+        return false;
+    }
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    size_t
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::PromoteHotItems() {
+        if (!hot_) return 0;
+        std::vector<HotnessSketch::Item> items;
+        hot_->TakeHot(&items);
+        
+        size_t moved = 0;
+        for (size_t k = 0; k < items.size(); k++) {
+            const size_t i = items[k].index;
+            const uint32_t tag = items[k].tag;
+            size_t index[num_candidate_buckets];
+            Candidates(i, tag, index);
+            if (table_->FindTagInBucket(index[0], tag)) continue;
+            size_t j = 1;
+            while (j < num_candidate_buckets && !table_->FindTagInBucket(index[j], tag)) j++;
+            if (j == num_candidate_buckets) continue;
             
-            for (size_t j=1; j<num_candidate_buckets; j++) {
-                index[j] = AltIndex(index[j-1], curtag);
+            // take the first candidate, kicking out its occupant if there is one
+            size_t at = index[0];
+            uint32_t occupant = 0;
+            uint32_t unused = 0;
+            if (!table_->InsertTagToBucket(at, tag, true, occupant)) {
+                size_t other[num_candidate_buckets];
+                Candidates(at, occupant, other);
+                size_t n = 1;
+                while (n < num_candidate_buckets &&
+                       !table_->InsertTagToBucket(other[n], occupant, false, unused)) n++;
+                if (n == num_candidate_buckets) {
+                    // no room for the occupant, put it back
+                    table_->InsertTagToBucket(at, occupant, true, unused);
+                    continue;
+                }
             }
-            
-            switch (rand() % (num_candidate_buckets-1)) {
-                case 0: index[0] = index[1]; break;
-                case 1: index[0] = index[2]; break;
-                case 2: index[0] = index[3]; break;
-                case 3: index[0] = index[4]; break;
+            table_->DeleteTagFromBucket(index[j], tag);
+            moved++;
+        }
+        hot_->Age();
+        return moved;
+    }//PromoteHotItems
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    size_t
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::FindDeferred(const size_t i, const uint32_t tag) const {
+        const std::vector<DeferredQueue::Item>& items = deferred_->items;
+        size_t index[num_candidate_buckets];
+        bool computed = false;
+        for (size_t k = 0; k < items.size(); k++) {
+            if (items[k].tag != tag) continue;
+            if (!computed) {
+                Candidates(i, tag, index);
+                computed = true;
             }
-            
-            if (table_->InsertTagToBucket(index[0], curtag, false, oldtag)) {
-                num_items_++;
-                return Ok;
+            if (std::find(index, index + num_candidate_buckets, items[k].index) !=
+                index + num_candidate_buckets) {
+                return k;
             }
         }
-
+        return items.size();
+    }//FindDeferred
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    void
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::KickDeferred() {
+        DeferredQueue::Item& item = deferred_->items.back();
+        TagSlots<TableType<bits_per_item> > slots(table_);
+        if (item.kicks == 0) {
+            // a new item, one of its candidates may have been freed since
+            size_t index[num_candidate_buckets];
+            Candidates(item.index, item.tag, index);
+            if (unrolledany<num_candidate_buckets>([&](auto j) {
+                    return slots.Insert(index[j], item.tag);
+                })) {
+                deferred_->PopBack();
+                return;
+            }
+            item.index = index[rand_r(&seed_) % num_candidate_buckets];
+        }
+        
+        // the random walk of PlaceTag, one kick at a time. A queued item sits
+        // under the slot it kicks next, one of its candidates.
+        if (Walk::Kick(geometry_, slots, &item.index, &item.tag, &seed_)) {
+            deferred_->PopBack();
+            return;
+        }
+        if (++item.kicks < kMaxCuckooCount) {
+            return;
+        }
+        
         std::cout << "Not Enough Space" << std::endl;
-        victim_.index = index[0];
-        victim_.tag = curtag;
+        victim_.index = item.index;
+        victim_.tag = item.tag;
         victim_.used = true;
-        return Ok;
-    }//AddImpl
+        num_items_--;
+        deferred_->PopBack();
+    }//KickDeferred
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    void
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::DrainDeferred() {
+        DeferredQueue* queue = deferred_;
+        std::unique_lock<std::mutex> lock(queue->mutex);
+        while (true) {
+            queue->work_cv.wait(lock, [&]() {
+                return queue->stop || (!queue->items.empty() && !victim_.used);
+            });
+            if (queue->items.empty() || victim_.used) {
+                // stopping, and nothing left that can be placed
+                queue->idle_cv.notify_all();
+                return;
+            }
+            for (size_t k = 0; k < kDeferredKicks && !queue->items.empty() && !victim_.used; k++) {
+                KickDeferred();
+            }
+            if (queue->items.empty() || victim_.used) {
+                queue->idle_cv.notify_all();
+            }
+            // hold the lock for a few kicks only, Add and Contain wait for it
+            lock.unlock();
+            std::this_thread::yield();
+            lock.lock();
+        }
+    }//DrainDeferred
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    void
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::EnableDeferredInserts(size_t capacity) {
+        if (deferred_) return;
+        deferred_ = new DeferredQueue(std::max((size_t) 1, capacity));
+        deferred_->worker = std::thread([this]() { DrainDeferred(); });
+    }
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    void
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::FlushDeferred() {
+        if (!deferred_) return;
+        std::unique_lock<std::mutex> lock(deferred_->mutex);
+        deferred_->idle_cv.wait(lock, [&]() {
+            return deferred_->items.empty() || victim_.used;
+        });
+    }
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    void
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::DisableDeferredInserts() {
+        if (!deferred_) return;
+        {
+            std::lock_guard<std::mutex> lock(deferred_->mutex);
+            deferred_->stop = true;
+        }
+        // the worker drains the queue before it stops
+        deferred_->work_cv.notify_one();
+        deferred_->worker.join();
+        num_items_ -= deferred_->items.size();
+        delete deferred_;
+        deferred_ = NULL;
+    }
     
     template <typename ItemType,
     size_t bits_per_item,
     size_t num_candidate_buckets,
     template<size_t> class TableType>
     Status
-    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::Contain(const ItemType& key) const {
-        bool found = false;
-        size_t index[5];
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::Delete(const ItemType& key) {
+        return DeleteHash(Hash(key));
+    }
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    Status
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::DeleteHash(const uint64_t hv) {
+        size_t i;
         uint32_t tag;
         
-        GenerateIndexTagHash(key, index, &tag);
-        for (size_t j =1; j<num_candidate_buckets; j++) {
-            index[j] = AltIndex(index[j-1], tag);
+        SplitHash(hv, &i, &tag);
+        return DeleteImpl(i, tag);
+    }
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    Status
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::DeleteImpl(const size_t i, const uint32_t tag) {
+        std::unique_lock<std::mutex> lock;
+        if (__builtin_expect(deferred_ != NULL, 0)) {
+            lock = std::unique_lock<std::mutex>(deferred_->mutex);
+            // a slot freed or a victim placed may let the worker go on
+            deferred_->work_cv.notify_one();
         }
-        assert(index[0] == AltIndex(index[num_candidate_buckets-1], tag));
         
-        for (size_t j =0; j<num_candidate_buckets; j++) {
-            found = found || (index[j] == victim_.index);
+        size_t index[num_candidate_buckets];
+        Candidates(i, tag, index);
+        
+        if (unrolledany<num_candidate_buckets>([&](auto j) {
+                return table_->DeleteTagFromBucket(index[j], tag);
+            })) {
+            num_items_--;
+            goto TryEliminateVictim;
+        }
+        
+        if (VictimMatch(tag, index)) {
+            victim_.used = false;
+            return Ok;
         }
-        found = found && victim_.used && (tag == victim_.tag);
         
-        for (size_t j =0; j<num_candidate_buckets; j++) {
-            if (found || table_->FindTagInBucket(index[j], tag)) {
+        if (deferred_) {
+            const size_t k = FindDeferred(i, tag);
+            if (k < deferred_->items.size()) {
+                deferred_->Remove(k);
+                num_items_--;
                 return Ok;
             }
         }
-        
         return NotFound;
+        
+    TryEliminateVictim:
+        if (victim_.used) {
+            victim_.used = false;
+            PlaceOrVictim(victim_.index, victim_.tag);
+        }
+        return Ok;
     }
     
     template <typename ItemType,
     size_t bits_per_item,
     size_t num_candidate_buckets,
     template<size_t> class TableType>
-    Status
-    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::Delete(const ItemType& key) {
-        size_t index[5];
-        uint32_t tag;
-        bool victim = false;
+    void
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::AddHashBatch(const uint64_t* hvs,
+                                                                                             size_t n,
+                                                                                             Status* statuses) {
+        size_t index[kBatchWindow];
+        uint32_t tag[kBatchWindow];
         
-        GenerateIndexTagHash(key, index, &tag);
-        for (size_t j =1; j<num_candidate_buckets; j++) {
-            index[j] = AltIndex(index[j-1], tag);
+        for (size_t base = 0; base < n; base += kBatchWindow) {
+            size_t m = std::min(kBatchWindow, n - base);
+            for (size_t k = 0; k < m; k++) {
+                SplitHash(hvs[base + k], &index[k], &tag[k]);
+                table_->PrefetchBucket(index[k]);
+            }
+            // insertions depend on each other, so only the first candidate of
+            // each item is prefetched
+            for (size_t k = 0; k < m; k++) {
+                if (deferred_) {
+                    // the victim belongs to the worker, AddImpl checks it under the lock
+                    statuses[base + k] = AddImpl(index[k], tag[k]);
+                } else {
+                    statuses[base + k] = victim_.used ? NotEnoughSpace : AddImpl(index[k], tag[k]);
+                }
+            }
         }
-        assert(index[0] == AltIndex(index[num_candidate_buckets-1], tag));
+    }
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    void
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::ContainHashBatch(const uint64_t* hvs,
+                                                                                                 size_t n,
+                                                                                                 Status* statuses) const {
+        size_t index[kBatchWindow][num_candidate_buckets];
+        uint32_t tag[kBatchWindow];
         
-        for (size_t j =0; j<num_candidate_buckets; j++) {
-            if (table_->DeleteTagFromBucket(index[j], tag)) {
-                num_items_--;
-                goto TryEliminateVictim;
+        for (size_t base = 0; base < n; base += kBatchWindow) {
+            size_t m = std::min(kBatchWindow, n - base);
+            for (size_t k = 0; k < m; k++) {
+                size_t i;
+                SplitHash(hvs[base + k], &i, &tag[k]);
+                Candidates(i, tag[k], index[k]);
+                unrolled<num_candidate_buckets>([&](auto j) {
+                    table_->PrefetchBucket(index[k][j]);
+                });
+            }
+            // the worker of deferred inserts moves tags while items are
+            // queued, the window is then probed under its lock
+            std::unique_lock<std::mutex> lock;
+            if (__builtin_expect(deferred_ != NULL && deferred_->Busy(), 0)) {
+                lock = std::unique_lock<std::mutex>(deferred_->mutex);
+            }
+            for (size_t k = 0; k < m; k++) {
+                bool found = VictimMatch(tag[k], index[k]) ||
+                    unrolledany<num_candidate_buckets>([&](auto j) {
+                        if (!table_->FindTagInBucket(index[k][j], tag[k])) return false;
+                        if (hot_ && j > 0) hot_->Record(index[k][0], tag[k]);
+                        return true;
+                    }) ||
+                    (lock.owns_lock() && FindDeferred(index[k][0], tag[k]) < deferred_->items.size());
+                statuses[base + k] = found ? Ok : NotFound;
+            }
+        }
+    }
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    void
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::DeleteHashBatch(const uint64_t* hvs,
+                                                                                                size_t n,
+                                                                                                Status* statuses) {
+        size_t index[kBatchWindow];
+        uint32_t tag[kBatchWindow];
+        
+        for (size_t base = 0; base < n; base += kBatchWindow) {
+            size_t m = std::min(kBatchWindow, n - base);
+            for (size_t k = 0; k < m; k++) {
+                SplitHash(hvs[base + k], &index[k], &tag[k]);
+                table_->PrefetchBucket(index[k]);
+            }
+            for (size_t k = 0; k < m; k++) {
+                statuses[base + k] = DeleteImpl(index[k], tag[k]);
+            }
+        }
+    }
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    void
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::MergeRange(const DaryCuckooFilter& other,
+                                                                                           size_t begin, size_t end,
+                                                                                           unsigned int* seed,
+                                                                                           size_t* num_added,
+                                                                                           std::vector<VictimCache>* leftover) {
+        const size_t n = other.table_->SizeInBuckets();
+        other.ForEachSlot(begin, end, [&](size_t s, uint32_t tag, uint32_t mark) {
+            VictimCache v;
+            if (PlaceTag(s + mark * n, tag, seed, &v.index, &v.tag)) {
+                (*num_added)++;
+            } else {
+                v.used = true;
+                leftover->push_back(v);
             }
+        });
+    }
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    Status
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::Merge(const DaryCuckooFilter& other) {
+        std::vector<const DaryCuckooFilter*> shards(1, &other);
+        return MergeShards(shards, this, 1);
+    }
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    Status
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::Intersect(const DaryCuckooFilter& other) {
+        if (!SameGeometry(other)) {
+            return NotSupported;
         }
         
-        for (size_t j =0; j<num_candidate_buckets; j++) {
-            victim = victim || (index[j] == victim_.index);
+        for (size_t s = 0; s < table_->SizeInBuckets(); s++) {
+            uint32_t tag = table_->ReadTag(s);
+            if (tag == 0) continue;
+            
+            size_t i = table_->IndexOfSlot(s);
+            if (!other.ContainImpl(i, tag, false)) {
+                table_->DeleteTagFromBucket(i, tag);
+                num_items_--;
+            }
         }
         
-        if (victim_.used && tag == victim_.tag && victim) {
+        if (victim_.used && !other.ContainImpl(victim_.index, victim_.tag, false)) {
             victim_.used = false;
-            return Ok;
-        } else {
-            return NotFound;
+        }
+        return Ok;
+    }
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    Status
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::MergeShards(const std::vector<const DaryCuckooFilter*>& shards,
+                                                                                            DaryCuckooFilter* out,
+                                                                                            size_t num_threads) {
+        for (size_t k = 0; k < shards.size(); k++) {
+            if (!out->SameGeometry(*shards[k])) {
+                return NotSupported;
+            }
+        }
+        if (out->victim_.used) {
+            return NotEnoughSpace;
         }
         
-    TryEliminateVictim:
+        size_t num_ranges = out->NumBlockRanges(num_threads);
+        std::vector<size_t> num_added(num_ranges, 0);
+        std::vector<std::vector<VictimCache> > leftover(num_ranges);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < num_ranges; t++) {
+            threads.push_back(std::thread([&, t]() {
+                size_t begin = out->BlockRangeBegin(t, num_ranges);
+                size_t end = out->BlockRangeBegin(t + 1, num_ranges);
+                unsigned int seed = out->seed_ + t;
+                for (size_t k = 0; k < shards.size(); k++) {
+                    out->MergeRange(*shards[k], begin, end, &seed, &num_added[t], &leftover[t]);
+                }
+            }));
+        }
+        for (size_t t = 0; t < num_ranges; t++) {
+            threads[t].join();
+            out->num_items_ += num_added[t];
+        }
+        
+        for (size_t k = 0; k < shards.size(); k++) {
+            if (shards[k]->victim_.used) {
+                leftover[0].push_back(shards[k]->victim_);
+            }
+        }
+        return out->AddLeftover(leftover);
+    }
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    Status
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::AddLeftover(const std::vector<std::vector<VictimCache> >& leftover) {
+        Status status = Ok;
+        for (size_t t = 0; t < leftover.size(); t++) {
+            for (size_t j = 0; j < leftover[t].size(); j++) {
+                if (victim_.used) {
+                    status = NotEnoughSpace;
+                    continue;
+                }
+                AddImpl(leftover[t][j].index, leftover[t][j].tag);
+            }
+        }
+        return status;
+    }
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    Status
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::ParallelBuild(const ItemType* keys,
+                                                                                              size_t n,
+                                                                                              size_t num_threads) {
         if (victim_.used) {
-            victim_.used = false;
-            size_t i = victim_.index;
-            uint32_t tag = victim_.tag;
-            AddImpl(i, tag);
+            return NotEnoughSpace;
+        }
+        num_threads = std::max((size_t) 1, num_threads);
+        size_t num_ranges = NumBlockRanges(num_threads);
+        
+        // phase 1: hash every key and count keys per block range in each chunk
+        std::vector<size_t> indices(n);
+        std::vector<uint32_t> tags(n);
+        std::vector<std::vector<size_t> > counts(num_threads, std::vector<size_t>(num_ranges, 0));
+        std::vector<std::thread> threads;
+        for (size_t c = 0; c < num_threads; c++) {
+            threads.push_back(std::thread([&, c]() {
+                for (size_t k = n * c / num_threads; k < n * (c + 1) / num_threads; k++) {
+                    GenerateIndexTagHash(keys[k], &indices[k], &tags[k]);
+                    counts[c][BlockRangeOf(indices[k], num_ranges)]++;
+                }
+            }));
+        }
+        for (size_t c = 0; c < num_threads; c++) {
+            threads[c].join();
+        }
+        threads.clear();
+        
+        // phase 2: group the hashes by block range, each chunk writing its own
+        // part of every group
+        std::vector<size_t> offsets(num_ranges + 1, 0);
+        std::vector<std::vector<size_t> > cursors(num_threads, std::vector<size_t>(num_ranges));
+        for (size_t t = 0; t < num_ranges; t++) {
+            size_t offset = offsets[t];
+            for (size_t c = 0; c < num_threads; c++) {
+                cursors[c][t] = offset;
+                offset += counts[c][t];
+            }
+            offsets[t + 1] = offset;
+        }
+        std::vector<VictimCache> grouped(n);
+        for (size_t c = 0; c < num_threads; c++) {
+            threads.push_back(std::thread([&, c]() {
+                for (size_t k = n * c / num_threads; k < n * (c + 1) / num_threads; k++) {
+                    VictimCache& v = grouped[cursors[c][BlockRangeOf(indices[k], num_ranges)]++];
+                    v.index = indices[k];
+                    v.tag = tags[k];
+                }
+            }));
+        }
+        for (size_t c = 0; c < num_threads; c++) {
+            threads[c].join();
+        }
+        threads.clear();
+        std::vector<size_t>().swap(indices);
+        std::vector<uint32_t>().swap(tags);
+        
+        // phase 3: place every group on its own block range
+        std::vector<size_t> num_added(num_ranges, 0);
+        std::vector<std::vector<VictimCache> > leftover(num_ranges);
+        for (size_t t = 0; t < num_ranges; t++) {
+            threads.push_back(std::thread([&, t]() {
+                unsigned int seed = seed_ + t;
+                for (size_t k = offsets[t]; k < offsets[t + 1]; k++) {
+                    VictimCache v;
+                    if (PlaceTag(grouped[k].index, grouped[k].tag, &seed, &v.index, &v.tag)) {
+                        num_added[t]++;
+                    } else {
+                        leftover[t].push_back(v);
+                    }
+                }
+            }));
+        }
+        for (size_t t = 0; t < num_ranges; t++) {
+            threads[t].join();
+            num_items_ += num_added[t];
+        }
+        
+        // phase 4: serial placement of whatever did not fit
+        return AddLeftover(leftover);
+    }
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    Status
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::ExportDelta(FilterDelta* delta) {
+        DirtyPages* dirty = table_->Dirty();
+        if (!dirty) {
+            return NotSupported;
+        }
+        
+        delta->base_version = delta_version_;
+        delta->version = ++delta_version_;
+        delta->table_bytes = table_->SizeInBytes();
+        delta->page_size = DirtyPages::kPageSize;
+        delta->num_items = num_items_;
+        delta->victim_index = victim_.index;
+        delta->victim_tag = victim_.tag;
+        delta->victim_used = victim_.used;
+        
+        delta->pages.clear();
+        delta->data.clear();
+        dirty->Collect(&delta->pages);
+        const char* bytes = table_->RawBytes();
+        for (size_t k = 0; k < delta->pages.size(); k++) {
+            size_t offset = delta->pages[k] * DirtyPages::kPageSize;
+            size_t length = std::min(DirtyPages::kPageSize, (size_t) delta->table_bytes - offset);
+            delta->data.append(bytes + offset, length);
+        }
+        return Ok;
+    }
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    void
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::ExportSnapshot(FilterDelta* snapshot) const {
+        snapshot->base_version = 0;
+        snapshot->version = delta_version_;
+        snapshot->table_bytes = table_->SizeInBytes();
+        snapshot->page_size = DirtyPages::kPageSize;
+        snapshot->num_items = num_items_;
+        snapshot->victim_index = victim_.index;
+        snapshot->victim_tag = victim_.tag;
+        snapshot->victim_used = victim_.used;
+        
+        const size_t num_pages = (snapshot->table_bytes + DirtyPages::kPageSize - 1) / DirtyPages::kPageSize;
+        snapshot->pages.resize(num_pages);
+        for (size_t k = 0; k < num_pages; k++) {
+            snapshot->pages[k] = k;
         }
+        snapshot->data.assign(table_->RawBytes(), snapshot->table_bytes);
+    }
+    
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets,
+    template<size_t> class TableType>
+    Status
+    DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, TableType>::ApplyDelta(const FilterDelta& delta) {
+        if (delta.table_bytes != table_->SizeInBytes() ||
+            delta.page_size != DirtyPages::kPageSize) {
+            return NotSupported;
+        }
+        if (delta.base_version == 0 ? delta.version < delta_version_
+                                    : delta.version <= delta_version_) {
+            return Ok;
+        }
+        if (delta.base_version > delta_version_) {
+            return NotSupported;
+        }
+        
+        // check every page before the first is copied, so a bad delta leaves
+        // the replica as it was
+        const size_t num_pages = (delta.table_bytes + DirtyPages::kPageSize - 1) / DirtyPages::kPageSize;
+        size_t total = 0;
+        for (size_t k = 0; k < delta.pages.size(); k++) {
+            if (delta.pages[k] >= num_pages) {
+                return NotSupported;
+            }
+            size_t offset = delta.pages[k] * DirtyPages::kPageSize;
+            total += std::min(DirtyPages::kPageSize, (size_t) delta.table_bytes - offset);
+        }
+        if (total != delta.data.size()) {
+            return NotSupported;
+        }
+        
+        // pages are absolute contents, so a delta can be applied more than once
+        char* bytes = table_->RawBytes();
+        DirtyPages* dirty = table_->Dirty();
+        size_t pos = 0;
+        for (size_t k = 0; k < delta.pages.size(); k++) {
+            size_t offset = delta.pages[k] * DirtyPages::kPageSize;
+            size_t length = std::min(DirtyPages::kPageSize, (size_t) delta.table_bytes - offset);
+            memcpy(bytes + offset, delta.data.data() + pos, length);
+            pos += length;
+            // a replica that tracks changes itself passes them on
+            if (dirty) dirty->Mark(offset);
+        }
+        
+        num_items_ = delta.num_items;
+        victim_.index = delta.victim_index;
+        victim_.tag = delta.victim_tag;
+        victim_.used = delta.victim_used;
+        delta_version_ = delta.version;
         return Ok;
     }
     
@@ -0,0 +1,292 @@
+// DaryCuckooMap is a d-ary Cuckoo filter that stores a small value next to every
+// tag, e.g. the shard or tier holding a key, so one probe answers both whether
+// a key is there and where it lives. Like membership, a lookup of a key that is
+// not there returns a value with the false positive rate of the filter, and a
+// stored key shares its tag with another key among its candidates about as
+// often; Lookup then reports nothing unless both hold the same value.
+#ifndef _D_ARY_CUCKOO_MAP_H_
+#define _D_ARY_CUCKOO_MAP_H_
+
+#include "d_ary_cuckoofilter.h"
+#include "valuetable.h"
+
+#include <optional>
+
+namespace d_ary_cuckoofilter {
+
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t bits_per_value,
+    size_t num_candidate_buckets>
+    class DaryCuckooMap {
+        static_assert(num_candidate_buckets >= 2 && num_candidate_buckets <= 8,
+                      "num_candidate_buckets must be 2 to 8");
+
+        typedef DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, SingleTable> Filter;
+        typedef CuckooWalk<bits_per_item, num_candidate_buckets> Walk;
+
+        // Storage of tags and values
+        ValueTable<bits_per_item, bits_per_value> *table_;
+
+        // Number of items stored
+        size_t num_items_;
+
+        TableGeometry geometry_;
+
+        typedef struct {
+            size_t index;
+            uint32_t tag;
+            uint32_t value;
+            bool used;
+        } VictimCache;
+
+        VictimCache victim_;
+
+        // state of the random walk of Add
+        unsigned int seed_;
+
+        inline void SplitHash(const uint64_t hv, size_t* index, uint32_t* tag) const {
+            Walk::SplitHash(geometry_, hv, index, tag);
+        }
+
+        inline void Candidates(const size_t i, const uint32_t tag,
+                               size_t (&index)[num_candidate_buckets]) const {
+            Walk::Candidates(geometry_, i, tag, index);
+        }
+
+        inline bool VictimMatch(const uint32_t tag,
+                                const size_t (&index)[num_candidate_buckets]) const {
+            return victim_.used && tag == victim_.tag && Walk::Among(victim_.index, index);
+        }
+
+        // slots for CuckooWalk; the value moves with its tag
+        struct ValueSlots {
+            struct Entry {
+                uint32_t tag;
+                uint32_t value;
+            };
+
+            ValueTable<bits_per_item, bits_per_value>* table;
+
+            explicit ValueSlots(ValueTable<bits_per_item, bits_per_value>* t): table(t) {}
+
+            inline uint32_t Tag(const Entry& e) const { return e.tag; }
+
+            inline bool Insert(const size_t i, const Entry& e) {
+                if (table->ReadTag(i) != 0) return false;
+                table->WriteSlot(i, e.tag, e.value);
+                return true;
+            }
+
+            inline bool Kick(const size_t i, const Entry& e, Entry* old) {
+                if (Insert(i, e)) return true;
+                old->tag = table->ReadTag(i);
+                old->value = table->ReadValue(i);
+                table->WriteSlot(i, e.tag, e.value);
+                return false;
+            }
+
+            inline void Prefetch(const size_t i) const { table->PrefetchBucket(i); }
+        };
+
+        // slot of tag among its candidates, num_buckets if it is not there
+        inline size_t Find(const size_t i, const uint32_t tag) const;
+
+        bool Place(const size_t i, const uint32_t tag, const uint32_t value);
+
+    public:
+        static const uint32_t kMaxValue = ValueTable<bits_per_item, bits_per_value>::VALUEMASK;
+
+        explicit DaryCuckooMap(const size_t max_num_keys):
+            num_items_(0), seed_(time(NULL)) {
+            table_ = new ValueTable<bits_per_item, bits_per_value>(num_candidate_buckets, max_num_keys);
+            geometry_ = table_->Geometry();
+            victim_.used = false;
+        }
+
+        ~DaryCuckooMap() {
+            delete table_;
+        }
+
+        // Add an item with a value of up to kMaxValue. Adding an item twice
+        // stores it twice; use Update to change its value.
+        Status Add(const ItemType& item, const uint32_t value);
+
+        // the value of item, nothing if it is not stored or if the slots
+        // matching it hold different values
+        std::optional<uint32_t> Lookup(const ItemType& item) const;
+
+        Status Contain(const ItemType& item) const;
+
+        // replace the value of a stored item in every slot matching it, which
+        // includes a key sharing its tag
+        Status Update(const ItemType& item, const uint32_t value);
+
+        Status Delete(const ItemType& item);
+
+        size_t Size() const { return num_items_; }
+
+        double LoadFactor() const { return 1.0 * Size() / table_->SizeInBuckets(); }
+
+        size_t SizeInBytes() const { return table_->SizeInBytes(); }
+
+        double BitsPerItem() const { return 8.0 * SizeInBytes() / Size(); }
+
+        std::string Info() const {
+            std::stringstream ss;
+            ss << "DaryCuckooMap Status:\n"
+               << "\t\t" << table_->Info() << "\n"
+               << "\t\tKeys stored: " << Size() << "\n"
+               << "\t\tLoad factor: " << LoadFactor() << "\n";
+            return ss.str();
+        }
+    };
+
+    template <typename ItemType, size_t bits_per_item, size_t bits_per_value, size_t num_candidate_buckets>
+    inline size_t
+    DaryCuckooMap<ItemType, bits_per_item, bits_per_value, num_candidate_buckets>::Find(const size_t i,
+                                                                                       const uint32_t tag) const {
+        // probe the index before hashing the tag, as DaryCuckooFilter does
+        if (table_->ReadTag(i) == tag) return i;
+        const uint64_t hv = offsethash(tag, geometry_.block_size);
+        size_t index = i;
+        for (size_t j = 1; j < num_candidate_buckets; j++) {
+            index = geometry_.AltIndex<num_candidate_buckets>(index, hv);
+            if (table_->ReadTag(index) == tag) return index;
+        }
+        return table_->SizeInBuckets();
+    }//Find
+
+    template <typename ItemType, size_t bits_per_item, size_t bits_per_value, size_t num_candidate_buckets>
+    bool
+    DaryCuckooMap<ItemType, bits_per_item, bits_per_value, num_candidate_buckets>::Place(const size_t i, const uint32_t tag,
+                                                                                        const uint32_t value) {
+        ValueSlots slots(table_);
+        typename ValueSlots::Entry victim;
+        if (Walk::Place(geometry_, slots, i, typename ValueSlots::Entry{tag, value}, &seed_,
+                        &victim_.index, &victim)) {
+            return true;
+        }
+        victim_.tag = victim.tag;
+        victim_.value = victim.value;
+        victim_.used = true;
+        return false;
+    }//Place
+
+    template <typename ItemType, size_t bits_per_item, size_t bits_per_value, size_t num_candidate_buckets>
+    Status
+    DaryCuckooMap<ItemType, bits_per_item, bits_per_value, num_candidate_buckets>::Add(const ItemType& item,
+                                                                                      const uint32_t value) {
+        if (victim_.used) {
+            return NotEnoughSpace;
+        }
+        if (value > kMaxValue) {
+            return NotSupported;
+        }
+        size_t i;
+        uint32_t tag;
+        SplitHash(Filter::Hash(item), &i, &tag);
+        // an item left over goes to the victim, which fails every later Add
+        if (Place(i, tag, value)) {
+            num_items_++;
+        }
+        return Ok;
+    }//Add
+
+    template <typename ItemType, size_t bits_per_item, size_t bits_per_value, size_t num_candidate_buckets>
+    std::optional<uint32_t>
+    DaryCuckooMap<ItemType, bits_per_item, bits_per_value, num_candidate_buckets>::Lookup(const ItemType& item) const {
+        size_t i;
+        uint32_t tag;
+        SplitHash(Filter::Hash(item), &i, &tag);
+        size_t index[num_candidate_buckets];
+        Candidates(i, tag, index);
+
+        // every match counts, the first one may belong to another key
+        std::optional<uint32_t> value;
+        for (size_t j = 0; j < num_candidate_buckets; j++) {
+            if (table_->ReadTag(index[j]) != tag) continue;
+            const uint32_t v = table_->ReadValue(index[j]);
+            if (value && *value != v) return std::nullopt;
+            value = v;
+        }
+        if (VictimMatch(tag, index)) {
+            if (value && *value != victim_.value) return std::nullopt;
+            value = victim_.value;
+        }
+        return value;
+    }//Lookup
+
+    template <typename ItemType, size_t bits_per_item, size_t bits_per_value, size_t num_candidate_buckets>
+    Status
+    DaryCuckooMap<ItemType, bits_per_item, bits_per_value, num_candidate_buckets>::Contain(const ItemType& item) const {
+        size_t i;
+        uint32_t tag;
+        SplitHash(Filter::Hash(item), &i, &tag);
+        if (Find(i, tag) < table_->SizeInBuckets()) {
+            return Ok;
+        }
+        if (__builtin_expect(victim_.used, 0)) {
+            size_t index[num_candidate_buckets];
+            Candidates(i, tag, index);
+            if (VictimMatch(tag, index)) return Ok;
+        }
+        return NotFound;
+    }//Contain
+
+    template <typename ItemType, size_t bits_per_item, size_t bits_per_value, size_t num_candidate_buckets>
+    Status
+    DaryCuckooMap<ItemType, bits_per_item, bits_per_value, num_candidate_buckets>::Update(const ItemType& item,
+                                                                                         const uint32_t value) {
+        if (value > kMaxValue) {
+            return NotSupported;
+        }
+        size_t i;
+        uint32_t tag;
+        SplitHash(Filter::Hash(item), &i, &tag);
+        size_t index[num_candidate_buckets];
+        Candidates(i, tag, index);
+
+        // all matches, so Lookup of the item agrees afterwards
+        bool found = false;
+        for (size_t j = 0; j < num_candidate_buckets; j++) {
+            if (table_->ReadTag(index[j]) != tag) continue;
+            table_->WriteSlot(index[j], tag, value);
+            found = true;
+        }
+        if (VictimMatch(tag, index)) {
+            victim_.value = value;
+            found = true;
+        }
+        return found ? Ok : NotFound;
+    }//Update
+
+    template <typename ItemType, size_t bits_per_item, size_t bits_per_value, size_t num_candidate_buckets>
+    Status
+    DaryCuckooMap<ItemType, bits_per_item, bits_per_value, num_candidate_buckets>::Delete(const ItemType& item) {
+        size_t i;
+        uint32_t tag;
+        SplitHash(Filter::Hash(item), &i, &tag);
+        const size_t slot = Find(i, tag);
+        if (slot < table_->SizeInBuckets()) {
+            table_->WriteSlot(slot, 0, 0);
+            num_items_--;
+            if (victim_.used) {
+                victim_.used = false;
+                if (Place(victim_.index, victim_.tag, victim_.value)) {
+                    num_items_++;
+                }
+            }
+            return Ok;
+        }
+        size_t index[num_candidate_buckets];
+        Candidates(i, tag, index);
+        if (VictimMatch(tag, index)) {
+            victim_.used = false;
+            return Ok;
+        }
+        return NotFound;
+    }//Delete
+}  // namespace d_ary_cuckoofilter
+
+#endif // #ifndef _D_ARY_CUCKOO_MAP_H_
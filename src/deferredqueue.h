@@ -0,0 +1,76 @@
+// DeferredQueue holds the items a DaryCuckooFilter with deferred inserts could
+// not place in one of their candidates, until its worker thread has kicked
+// them into the table. Every item is a tag without a slot, like the victim:
+// either a new item under its index, or a tag the worker evicted, under the
+// candidate it kicks next.
+#ifndef _DEFERRED_QUEUE_H_
+#define _DEFERRED_QUEUE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace d_ary_cuckoofilter {
+
+    struct DeferredQueue {
+        struct Item {
+            size_t index;
+            uint32_t tag;
+            // kicks spent on the item so far
+            uint32_t kicks;
+        };
+
+        // guards the queue and, while the queue exists, the table, the item
+        // count and the victim of the filter
+        std::mutex mutex;
+
+        // wakes the worker when there is work or it has to stop
+        std::condition_variable work_cv;
+
+        // wakes callers waiting for the queue to drain
+        std::condition_variable idle_cv;
+
+        std::vector<Item> items;
+        size_t capacity;
+
+        // items.size(), stored under mutex whenever items changes. Only the
+        // foreground thread adds items, so once it reads 0 the worker is idle
+        // and reads may skip the lock.
+        std::atomic<size_t> pending;
+
+        bool stop;
+
+        std::thread worker;
+
+        explicit DeferredQueue(size_t capacity): capacity(capacity), pending(0), stop(false) {
+            items.reserve(capacity);
+        }
+
+        // true if a reader has to take the lock
+        bool Busy() const {
+            return pending.load(std::memory_order_acquire) != 0;
+        }
+
+        void Push(const Item& item) {
+            items.push_back(item);
+            pending.store(items.size(), std::memory_order_release);
+        }
+
+        void PopBack() {
+            items.pop_back();
+            pending.store(items.size(), std::memory_order_release);
+        }
+
+        // remove items[k], order does not matter
+        void Remove(size_t k) {
+            items[k] = items.back();
+            PopBack();
+        }
+    };
+}
+
+#endif // #ifndef _DEFERRED_QUEUE_H_
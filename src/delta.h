@@ -0,0 +1,96 @@
+// FilterDelta carries the table pages changed since the previous delta of a
+// filter, together with its item count and victim, to replicas of that filter
+#ifndef _DELTA_H_
+#define _DELTA_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace d_ary_cuckoofilter {
+
+    struct FilterDelta {
+        // deltas are numbered 1, 2, ... and base_version is the number of the
+        // previous one; a full snapshot has base_version 0
+        uint64_t base_version;
+        uint64_t version;
+
+        // layout of the table, must match on the replica
+        uint64_t table_bytes;
+        uint64_t page_size;
+
+        // filter state, replaced as a whole
+        uint64_t num_items;
+        uint64_t victim_index;
+        uint32_t victim_tag;
+        uint32_t victim_used;
+
+        // page numbers and their contents, page_size bytes each except for a
+        // short last page of the table
+        std::vector<uint64_t> pages;
+        std::string data;
+
+        FilterDelta(): base_version(0), version(0), table_bytes(0), page_size(0),
+                       num_items(0), victim_index(0), victim_tag(0), victim_used(0) {}
+
+        static constexpr uint32_t kMagic = 0x44464344; // "DCFD"
+
+        std::string Serialize() const {
+            std::string out;
+            uint64_t num_pages = pages.size();
+            Append(&out, kMagic);
+            Append(&out, base_version);
+            Append(&out, version);
+            Append(&out, table_bytes);
+            Append(&out, page_size);
+            Append(&out, num_items);
+            Append(&out, victim_index);
+            Append(&out, victim_tag);
+            Append(&out, victim_used);
+            Append(&out, num_pages);
+            out.append((const char*) pages.data(), num_pages * sizeof(uint64_t));
+            out.append(data);
+            return out;
+        }
+
+        // false if in is not a complete delta
+        bool Deserialize(const std::string& in) {
+            size_t pos = 0;
+            uint32_t magic;
+            uint64_t num_pages;
+            if (!Read(in, &pos, &magic) || magic != kMagic ||
+                !Read(in, &pos, &base_version) || !Read(in, &pos, &version) ||
+                !Read(in, &pos, &table_bytes) || !Read(in, &pos, &page_size) ||
+                !Read(in, &pos, &num_items) || !Read(in, &pos, &victim_index) ||
+                !Read(in, &pos, &victim_tag) || !Read(in, &pos, &victim_used) ||
+                !Read(in, &pos, &num_pages)) {
+                return false;
+            }
+            if ((in.size() - pos) / sizeof(uint64_t) < num_pages) {
+                return false;
+            }
+            pages.resize(num_pages);
+            memcpy(pages.data(), in.data() + pos, num_pages * sizeof(uint64_t));
+            pos += num_pages * sizeof(uint64_t);
+            data.assign(in, pos, std::string::npos);
+            return true;
+        }
+
+    private:
+        template <typename T>
+        static void Append(std::string* out, const T& v) {
+            out->append((const char*) &v, sizeof(v));
+        }
+
+        template <typename T>
+        static bool Read(const std::string& in, size_t* pos, T* v) {
+            if (in.size() - *pos < sizeof(T)) return false;
+            memcpy(v, in.data() + *pos, sizeof(T));
+            *pos += sizeof(T);
+            return true;
+        }
+    };
+}
+
+#endif // #ifndef _DELTA_H_
@@ -0,0 +1,60 @@
+// DirtyPages remembers which pages of a table were written since it was last
+// cleared, so only those pages need to be shipped to replicas
+#ifndef _DIRTY_PAGES_H_
+#define _DIRTY_PAGES_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+namespace d_ary_cuckoofilter {
+
+    class DirtyPages {
+        std::vector<std::atomic<uint64_t> > words_;
+        size_t num_pages_;
+
+    public:
+        static constexpr size_t kPageShift = 12;
+        static constexpr size_t kPageSize = 1 << kPageShift;
+
+        explicit DirtyPages(size_t num_bytes):
+            words_((((num_bytes + kPageSize - 1) >> kPageShift) + 63) / 64),
+            num_pages_((num_bytes + kPageSize - 1) >> kPageShift) {}
+
+        size_t NumPages() const { return num_pages_; }
+
+        // tables may be written from several threads at once
+        inline void Mark(const size_t byte_offset) {
+            const size_t page = byte_offset >> kPageShift;
+            const uint64_t bit = 1ULL << (page & 63);
+            std::atomic<uint64_t>& word = words_[page >> 6];
+            if (!(word.load(std::memory_order_relaxed) & bit)) {
+                word.fetch_or(bit, std::memory_order_relaxed);
+            }
+        }
+
+        void MarkAll() {
+            for (size_t p = 0; p < num_pages_; p++) {
+                Mark(p << kPageShift);
+            }
+        }
+
+        bool IsDirty(const size_t page) const {
+            return words_[page >> 6].load(std::memory_order_relaxed) & (1ULL << (page & 63));
+        }
+
+        // append the dirty pages to pages and mark everything clean
+        void Collect(std::vector<uint64_t>* pages) {
+            for (size_t w = 0; w < words_.size(); w++) {
+                uint64_t bits = words_[w].exchange(0, std::memory_order_relaxed);
+                while (bits) {
+                    pages->push_back(w * 64 + __builtin_ctzll(bits));
+                    bits &= bits - 1;
+                }
+            }
+        }
+    };
+}
+
+#endif // #ifndef _DIRTY_PAGES_H_
@@ -0,0 +1,283 @@
+// FuseFilter is an immutable filter for sets that are built once and then only
+// queried: a binary fuse filter (Graf and Lemire), an array of fingerprints in
+// which an item is in the set if the fingerprints of its 3 cells xor to its own
+// fingerprint. It takes about 1.125 * bits_per_item bits per item for a false
+// positive rate of 2^-bits_per_item, with exactly 3 probes per lookup and no
+// victim. Items are hashed as by DaryCuckooFilter, so the same KeyTraits and
+// pre-hashed entry points apply.
+#ifndef _FUSE_FILTER_H_
+#define _FUSE_FILTER_H_
+
+#include "d_ary_cuckoofilter.h"
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+namespace d_ary_cuckoofilter {
+
+    // seeds tried before a build gives up; one fails with probability about
+    // 1 / n, so a second is rarely needed
+    const size_t kMaxFuseAttempts = 100;
+
+    template <typename ItemType,
+    size_t bits_per_item>
+    class FuseFilter {
+        static_assert(bits_per_item == 8 || bits_per_item == 16 || bits_per_item == 32,
+                      "FuseFilter supports 8, 16 and 32-bit fingerprints");
+
+        // the hash is the same for every arity, any filter type will do
+        typedef DaryCuckooFilter<ItemType, bits_per_item, 4, SingleTable> Filter;
+
+        typedef typename TagWord<bits_per_item>::type Word;
+
+        // hashes added and not yet built, released by Freeze
+        std::vector<uint64_t> pending_;
+
+        std::vector<Word> fingerprints_;
+
+        uint64_t seed_;
+        size_t segment_length_;
+        size_t segment_length_mask_;
+        size_t segment_count_length_;
+
+        size_t num_items_;
+
+        bool frozen_;
+
+        inline uint64_t Mix(const uint64_t hv) const {
+            return mix64(hv + seed_);
+        }
+
+        static inline Word Fingerprint(const uint64_t h) {
+            return (Word) (h ^ (h >> 32));
+        }
+
+        // the 3 cells of h, each in its own segment of 3 consecutive ones
+        inline void Cells(const uint64_t h, size_t (&cell)[3]) const {
+            cell[0] = (size_t) (((__uint128_t) h * segment_count_length_) >> 64);
+            cell[1] = cell[0] + segment_length_;
+            cell[2] = cell[1] + segment_length_;
+            cell[1] ^= (size_t) (h >> 18) & segment_length_mask_;
+            cell[2] ^= (size_t) h & segment_length_mask_;
+        }
+
+        void Layout(size_t n);
+
+        // one attempt at peeling the hashes with the current seed
+        bool TryBuild(const std::vector<uint64_t>& hvs);
+
+    public:
+        FuseFilter(): seed_(0), segment_length_(0), segment_length_mask_(0),
+                      segment_count_length_(0), num_items_(0), frozen_(false) {}
+
+        // Add an item to the set to build. Items can be added only until Freeze.
+        Status Add(const ItemType& item) { return AddHash(Filter::Hash(item)); }
+
+        Status AddHash(const uint64_t hv) {
+            if (frozen_) return NotSupported;
+            pending_.push_back(hv);
+            return Ok;
+        }
+
+        // Build the filter from the items added. An item added twice counts
+        // once. NotEnoughSpace if no seed worked, which takes a broken hash.
+        Status Freeze();
+
+        // Add the keys and Freeze
+        Status BuildStatic(const ItemType* keys, size_t n);
+
+        Status BuildStaticHashes(const uint64_t* hvs, size_t n);
+
+        bool Frozen() const { return frozen_; }
+
+        // Report if the item is in the set, with false positive rate.
+        // NotSupported before Freeze.
+        Status Contain(const ItemType& item) const { return ContainHash(Filter::Hash(item)); }
+
+        Status ContainHash(const uint64_t hv) const {
+            if (!frozen_) return NotSupported;
+            const uint64_t h = Mix(hv);
+            size_t cell[3];
+            Cells(h, cell);
+            const Word f = Fingerprint(h) ^ fingerprints_[cell[0]] ^
+                           fingerprints_[cell[1]] ^ fingerprints_[cell[2]];
+            return f == 0 ? Ok : NotFound;
+        }
+
+        // batched form, prefetching the cells kBatchWindow items ahead
+        void ContainHashBatch(const uint64_t* hvs, size_t n, Status* statuses) const;
+
+        // number of distinct items the filter was built from
+        size_t Size() const { return num_items_; }
+
+        size_t SizeInBytes() const { return fingerprints_.size() * sizeof(Word); }
+
+        size_t SizeInBits() const { return SizeInBytes() * 8; }
+
+        double BitsPerItem() const { return 1.0 * SizeInBits() / Size(); }
+
+        std::string Info() const {
+            std::stringstream ss;
+            ss << "FuseFilter Status:\n"
+               << "\t\tFingerprint size: " << bits_per_item << " bits\n"
+               << "\t\tCells: " << fingerprints_.size() << "\n"
+               << "\t\tSegment length: " << segment_length_ << "\n"
+               << "\t\tKeys stored: " << Size() << "\n"
+               << "\t\tBit/key: " << BitsPerItem() << "\n";
+            return ss.str();
+        }
+    };
+
+    template <typename ItemType, size_t bits_per_item>
+    void
+    FuseFilter<ItemType, bits_per_item>::Layout(size_t n) {
+        // sizes from the binary fuse paper for arity 3
+        segment_length_ = n == 0 ? 4 : (size_t) 1 << (int) floor(log((double) n) / log(3.33) + 2.25);
+        segment_length_ = std::min(segment_length_, (size_t) 1 << 18);
+        segment_length_mask_ = segment_length_ - 1;
+        const double size_factor = n <= 1 ? 0 : std::max(1.125, 0.875 + 0.25 * log(1000000.0) / log((double) n));
+        const size_t capacity = (size_t) round(n * size_factor);
+        const size_t segments = (capacity + segment_length_ - 1) / segment_length_;
+        const size_t segment_count = segments > 2 ? segments - 2 : 1;
+        segment_count_length_ = segment_count * segment_length_;
+        fingerprints_.assign((segment_count + 2) * segment_length_, 0);
+    }
+
+    template <typename ItemType, size_t bits_per_item>
+    bool
+    FuseFilter<ItemType, bits_per_item>::TryBuild(const std::vector<uint64_t>& hvs) {
+        const size_t num_cells = fingerprints_.size();
+        const size_t n = hvs.size();
+
+        // per cell the number of hashes on it times 4 plus the xor of which of
+        // their 3 cells it is, and the xor of the hashes; a cell with one hash
+        // left thus knows it
+        std::vector<uint8_t> count(num_cells, 0);
+        std::vector<uint64_t> xors(num_cells, 0);
+        for (size_t k = 0; k < n; k++) {
+            const uint64_t h = Mix(hvs[k]);
+            size_t cell[3];
+            Cells(h, cell);
+            for (uint8_t j = 0; j < 3; j++) {
+                if (count[cell[j]] >= 0xFC) return false;
+                count[cell[j]] += 4;
+                count[cell[j]] ^= j;
+                xors[cell[j]] ^= h;
+            }
+        }
+
+        // peel cells holding one hash, recording the order
+        std::vector<size_t> alone;
+        alone.reserve(num_cells);
+        for (size_t c = 0; c < num_cells; c++) {
+            if ((count[c] >> 2) == 1) alone.push_back(c);
+        }
+        std::vector<uint64_t> order;
+        std::vector<uint8_t> order_cell;
+        order.reserve(n);
+        order_cell.reserve(n);
+        while (!alone.empty()) {
+            const size_t c = alone.back();
+            alone.pop_back();
+            if ((count[c] >> 2) != 1) continue;
+            const uint64_t h = xors[c];
+            const uint8_t found = count[c] & 3;
+            order.push_back(h);
+            order_cell.push_back(found);
+
+            size_t cell[3];
+            Cells(h, cell);
+            for (uint8_t j = 0; j < 3; j++) {
+                if (j == found) continue;
+                const size_t other = cell[j];
+                if ((count[other] >> 2) == 2) alone.push_back(other);
+                count[other] -= 4;
+                count[other] ^= j;
+                xors[other] ^= h;
+            }
+            count[c] = 0;
+        }
+        if (order.size() != n) return false;
+
+        // assign in reverse, the cell an item was peeled from is free to set
+        for (size_t k = n; k-- > 0;) {
+            const uint64_t h = order[k];
+            size_t cell[3];
+            Cells(h, cell);
+            const size_t c = cell[order_cell[k]];
+            fingerprints_[c] = 0;
+            fingerprints_[c] = Fingerprint(h) ^ fingerprints_[cell[0]] ^
+                               fingerprints_[cell[1]] ^ fingerprints_[cell[2]];
+        }
+        return true;
+    }
+
+    template <typename ItemType, size_t bits_per_item>
+    Status
+    FuseFilter<ItemType, bits_per_item>::Freeze() {
+        if (frozen_) return Ok;
+
+        // equal hashes would never peel
+        std::vector<uint64_t> hvs;
+        hvs.swap(pending_);
+        std::sort(hvs.begin(), hvs.end());
+        hvs.erase(std::unique(hvs.begin(), hvs.end()), hvs.end());
+
+        Layout(hvs.size());
+        uint64_t seed = 0x726b2b9d438b9d4dULL;
+        for (size_t attempt = 0; attempt < kMaxFuseAttempts; attempt++) {
+            seed_ = mix64(seed + attempt);
+            if (TryBuild(hvs)) {
+                num_items_ = hvs.size();
+                frozen_ = true;
+                return Ok;
+            }
+            std::fill(fingerprints_.begin(), fingerprints_.end(), 0);
+        }
+        // keep the items, a retry is up to the caller
+        pending_.swap(hvs);
+        return NotEnoughSpace;
+    }
+
+    template <typename ItemType, size_t bits_per_item>
+    Status
+    FuseFilter<ItemType, bits_per_item>::BuildStatic(const ItemType* keys, size_t n) {
+        if (frozen_) return NotSupported;
+        pending_.reserve(pending_.size() + n);
+        for (size_t k = 0; k < n; k++) {
+            pending_.push_back(Filter::Hash(keys[k]));
+        }
+        return Freeze();
+    }
+
+    template <typename ItemType, size_t bits_per_item>
+    Status
+    FuseFilter<ItemType, bits_per_item>::BuildStaticHashes(const uint64_t* hvs, size_t n) {
+        if (frozen_) return NotSupported;
+        pending_.insert(pending_.end(), hvs, hvs + n);
+        return Freeze();
+    }
+
+    template <typename ItemType, size_t bits_per_item>
+    void
+    FuseFilter<ItemType, bits_per_item>::ContainHashBatch(const uint64_t* hvs, size_t n,
+                                                          Status* statuses) const {
+        if (!frozen_) {
+            std::fill(statuses, statuses + n, NotSupported);
+            return;
+        }
+        for (size_t k = 0; k < n; k++) {
+            if (k + kBatchWindow < n) {
+                size_t cell[3];
+                Cells(Mix(hvs[k + kBatchWindow]), cell);
+                for (size_t j = 0; j < 3; j++) {
+                    _mm_prefetch((const char*) &fingerprints_[cell[j]], _MM_HINT_T0);
+                }
+            }
+            statuses[k] = ContainHash(hvs[k]);
+        }
+    }
+}  // namespace d_ary_cuckoofilter
+
+#endif // #ifndef _FUSE_FILTER_H_
@@ -0,0 +1,298 @@
+// GenerationalCuckooFilter holds the items added during the last
+// num_generations generations, e.g. "seen in the last N minutes" with one
+// generation per N / num_generations minutes. Every slot carries the 8-bit
+// generation it was added in; a slot of an expired generation counts as empty,
+// so advancing the window invalidates the oldest generation without touching
+// the table. A sweep clears a few expired slots per Advance, before their
+// generation number comes around again.
+#ifndef _GENERATIONAL_CUCKOO_FILTER_H_
+#define _GENERATIONAL_CUCKOO_FILTER_H_
+
+#include "d_ary_cuckoofilter.h"
+
+#include <vector>
+
+namespace d_ary_cuckoofilter {
+
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets>
+    class GenerationalCuckooFilter {
+        static_assert(num_candidate_buckets >= 2 && num_candidate_buckets <= 8,
+                      "num_candidate_buckets must be 2 to 8");
+
+        typedef DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, SingleTable> Filter;
+        typedef CuckooWalk<bits_per_item, num_candidate_buckets> Walk;
+
+        // generation numbers wrap around after this many generations
+        static const size_t kGenerationPeriod = 256;
+
+        // Storage of tags
+        SingleTable<bits_per_item> *table_;
+
+        TableGeometry geometry_;
+
+        // generation of every slot, meaningful for slots with a tag
+        std::vector<uint8_t> generations_;
+
+        size_t num_generations_;
+
+        // number of the current generation, starting at 0
+        uint64_t epoch_;
+
+        // items added in each generation and still stored, and their sum over
+        // the live generations
+        size_t generation_items_[kGenerationPeriod];
+        size_t num_items_;
+
+        // next slot the sweep looks at
+        size_t sweep_cursor_;
+
+        typedef struct {
+            size_t index;
+            uint32_t tag;
+            uint8_t generation;
+            bool used;
+        } VictimCache;
+
+        VictimCache victim_;
+
+        // state of the random walk of Add
+        unsigned int seed_;
+
+        inline void SplitHash(const uint64_t hv, size_t* index, uint32_t* tag) const {
+            Walk::SplitHash(geometry_, hv, index, tag);
+        }
+
+        inline uint8_t CurrentGeneration() const {
+            return (uint8_t) epoch_;
+        }
+
+        inline bool Live(const uint8_t generation) const {
+            return (uint8_t) (CurrentGeneration() - generation) < num_generations_;
+        }
+
+        // a slot of an expired generation is free
+        inline bool Occupied(const size_t i) const {
+            return table_->ReadTag(i) != 0 && Live(generations_[i]);
+        }
+
+        inline bool Match(const size_t i, const uint32_t tag) const {
+            return table_->ReadTag(i) == tag && Live(generations_[i]);
+        }
+
+        inline void Store(const size_t i, const uint32_t tag, const uint8_t generation) {
+            table_->WriteTag(i, tag);
+            generations_[i] = generation;
+        }
+
+        inline void Candidates(const size_t i, const uint32_t tag,
+                               size_t (&index)[num_candidate_buckets]) const {
+            Walk::Candidates(geometry_, i, tag, index);
+        }
+
+        inline bool VictimMatch(const uint32_t tag,
+                                const size_t (&index)[num_candidate_buckets]) const {
+            return victim_.used && tag == victim_.tag && Live(victim_.generation) &&
+                   Walk::Among(victim_.index, index);
+        }
+
+        // slots for CuckooWalk; a slot of an expired generation is empty, and an
+        // evicted item keeps its generation
+        struct GenerationSlots {
+            struct Entry {
+                uint32_t tag;
+                uint8_t generation;
+            };
+
+            GenerationalCuckooFilter* filter;
+
+            explicit GenerationSlots(GenerationalCuckooFilter* f): filter(f) {}
+
+            inline uint32_t Tag(const Entry& e) const { return e.tag; }
+
+            inline bool Insert(const size_t i, const Entry& e) {
+                if (filter->Occupied(i)) return false;
+                filter->Store(i, e.tag, e.generation);
+                return true;
+            }
+
+            inline bool Kick(const size_t i, const Entry& e, Entry* old) {
+                if (Insert(i, e)) return true;
+                old->tag = filter->table_->ReadTag(i);
+                old->generation = filter->generations_[i];
+                filter->Store(i, e.tag, e.generation);
+                return false;
+            }
+
+            inline void Prefetch(const size_t i) const { filter->table_->PrefetchBucket(i); }
+        };
+
+        bool Place(const size_t i, const uint32_t tag, const uint8_t generation);
+
+        // clear every slot of an expired generation in the next num_slots slots
+        void Sweep(size_t num_slots);
+
+    public:
+        // num_generations is 1 to 128
+        explicit GenerationalCuckooFilter(const size_t max_live_keys, const size_t num_generations):
+            num_generations_(std::max((size_t) 1, std::min(num_generations, kGenerationPeriod / 2))),
+            epoch_(0), num_items_(0), sweep_cursor_(0), seed_(time(NULL)) {
+            table_ = new SingleTable<bits_per_item>(num_candidate_buckets, max_live_keys);
+            geometry_ = table_->Geometry();
+            generations_.resize(table_->SizeInBuckets());
+            for (size_t g = 0; g < kGenerationPeriod; g++) generation_items_[g] = 0;
+            victim_.used = false;
+        }
+
+        ~GenerationalCuckooFilter() {
+            delete table_;
+        }
+
+        // Add an item to the current generation
+        Status Add(const ItemType& item);
+
+        // Report if the item was added in one of the live generations
+        Status Contain(const ItemType& item) const;
+
+        Status Delete(const ItemType& item);
+
+        // Start a new generation, dropping the oldest one. The sweep spreads
+        // the clearing of a whole table over the generations it takes the
+        // generation number to wrap around, so one call is O(1) per item added
+        // in a generation.
+        void Advance();
+
+        uint64_t Generation() const { return epoch_; }
+
+        size_t NumGenerations() const { return num_generations_; }
+
+        // items of the live generations
+        size_t Size() const { return num_items_; }
+
+        double LoadFactor() const { return 1.0 * Size() / table_->SizeInBuckets(); }
+
+        // generations count as 8 bits per slot
+        size_t SizeInBits() const {
+            return table_->SizeInBytes() * 8 + generations_.size() * 8;
+        }
+
+        double BitsPerItem() const { return 1.0 * SizeInBits() / Size(); }
+    };
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    bool
+    GenerationalCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Place(const size_t i, const uint32_t tag,
+                                                                                   const uint8_t generation) {
+        GenerationSlots slots(this);
+        typename GenerationSlots::Entry victim;
+        if (Walk::Place(geometry_, slots, i, typename GenerationSlots::Entry{tag, generation}, &seed_,
+                        &victim_.index, &victim)) {
+            return true;
+        }
+        victim_.tag = victim.tag;
+        victim_.generation = victim.generation;
+        victim_.used = true;
+        return false;
+    }//Place
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    Status
+    GenerationalCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Add(const ItemType& item) {
+        if (victim_.used) {
+            return NotEnoughSpace;
+        }
+        size_t i;
+        uint32_t tag;
+        SplitHash(Filter::Hash(item), &i, &tag);
+        generation_items_[CurrentGeneration()]++;
+        num_items_++;
+        // an item left over goes to the victim, which fails every later Add
+        // until a Delete or Advance makes room
+        Place(i, tag, CurrentGeneration());
+        return Ok;
+    }//Add
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    Status
+    GenerationalCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Contain(const ItemType& item) const {
+        size_t i;
+        uint32_t tag;
+        SplitHash(Filter::Hash(item), &i, &tag);
+        size_t index[num_candidate_buckets];
+        Candidates(i, tag, index);
+
+        for (size_t j = 0; j < num_candidate_buckets; j++) {
+            if (Match(index[j], tag)) return Ok;
+        }
+        return VictimMatch(tag, index) ? Ok : NotFound;
+    }//Contain
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    Status
+    GenerationalCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Delete(const ItemType& item) {
+        size_t i;
+        uint32_t tag;
+        SplitHash(Filter::Hash(item), &i, &tag);
+        size_t index[num_candidate_buckets];
+        Candidates(i, tag, index);
+
+        for (size_t j = 0; j < num_candidate_buckets; j++) {
+            if (!Match(index[j], tag)) continue;
+            generation_items_[generations_[index[j]]]--;
+            num_items_--;
+            table_->WriteTag(index[j], 0);
+            if (victim_.used) {
+                victim_.used = false;
+                Place(victim_.index, victim_.tag, victim_.generation);
+            }
+            return Ok;
+        }
+        if (VictimMatch(tag, index)) {
+            generation_items_[victim_.generation]--;
+            num_items_--;
+            victim_.used = false;
+            return Ok;
+        }
+        return NotFound;
+    }//Delete
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    void
+    GenerationalCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Sweep(size_t num_slots) {
+        const size_t n = table_->SizeInBuckets();
+        for (size_t k = 0; k < num_slots; k++) {
+            const size_t s = sweep_cursor_;
+            if (table_->ReadTag(s) != 0 && !Live(generations_[s])) {
+                table_->WriteTag(s, 0);
+            }
+            if (++sweep_cursor_ == n) sweep_cursor_ = 0;
+        }
+    }//Sweep
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    void
+    GenerationalCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Advance() {
+        epoch_++;
+        // the generation that just expired, and the number the new one reuses
+        num_items_ -= generation_items_[(uint8_t) (epoch_ - num_generations_)];
+        generation_items_[(uint8_t) (epoch_ - num_generations_)] = 0;
+        generation_items_[CurrentGeneration()] = 0;
+
+        // A slot expires num_generations after it was written, and its number
+        // comes around again kGenerationPeriod after. Sweeping the table once in
+        // every kGenerationPeriod - num_generations calls clears it in between.
+        const size_t period = kGenerationPeriod - num_generations_;
+        Sweep((table_->SizeInBuckets() + period - 1) / period);
+
+        // expired space may take the victim now
+        if (victim_.used) {
+            victim_.used = false;
+            if (Live(victim_.generation)) {
+                Place(victim_.index, victim_.tag, victim_.generation);
+            }
+        }
+    }//Advance
+}  // namespace d_ary_cuckoofilter
+
+#endif // #ifndef _GENERATIONAL_CUCKOO_FILTER_H_
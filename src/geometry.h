@@ -0,0 +1,176 @@
+// Table geometry of d-ary Cuckoo filter: integer-exact powers and base-d digit
+// arithmetic, and the block layout of a table computed once at construction
+#ifndef _GEOMETRY_H_
+#define _GEOMETRY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+namespace d_ary_cuckoofilter {
+
+    // base^exp, exact as long as it fits in 64 bits
+    constexpr uint64_t ipow(uint64_t base, size_t exp) {
+        uint64_t p = 1;
+        for (size_t i = 0; i < exp; i++) p *= base;
+        return p;
+    }
+
+    // smallest power of base not less than x, 0 if it does not fit in 64 bits
+    constexpr uint64_t upperpower(uint64_t x, uint64_t base) {
+        uint64_t p = 1;
+        while (p < x) {
+            if (p > UINT64_MAX / base) return 0;
+            p *= base;
+        }
+        return p;
+    }
+
+    // number of base-ary digits needed to write any value below x
+    constexpr size_t numdigits(uint64_t x, uint64_t base) {
+        size_t n = 0;
+        for (uint64_t p = 1; p < x; n++) {
+            if (p > UINT64_MAX / base) return n + 1;
+            p *= base;
+        }
+        return n;
+    }
+
+    // splitmix64 finalizer, spreads every input bit over the whole word
+    inline uint64_t mix64(uint64_t x) {
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+
+    // mask of the top bit of every lane_bits-wide lane of a word
+    constexpr uint64_t lanehighbits(size_t lane_bits) {
+        uint64_t mask = 0;
+        for (size_t bit = lane_bits - 1; bit < 64; bit += lane_bits) mask |= 1ULL << bit;
+        return mask;
+    }
+
+    // digit-wise addition modulo base of the lowest num_digits digits of a and b.
+    // base is a compile-time constant so the divisions turn into multiplications;
+    // power-of-2 bases work on whole words.
+    template <size_t base>
+    inline uint64_t digitadd(uint64_t a, uint64_t b, size_t num_digits) {
+        if constexpr (base == 2) {
+            return a ^ b;
+        } else if constexpr ((base & (base - 1)) == 0) {
+            // add the digits as lanes of bits and drop the carry out of every lane
+            const uint64_t high = lanehighbits(__builtin_ctzll(base));
+            return ((a & ~high) + (b & ~high)) ^ ((a ^ b) & high);
+        } else {
+            uint64_t result = 0;
+            uint64_t p = 1;
+            for (size_t i = 0; i < num_digits; i++) {
+                uint64_t s = a % base + b % base;
+                if (s >= base) s -= base;
+                result += s * p;
+                a /= base;
+                b /= base;
+                p *= base;
+            }
+            return result;
+        }
+    }
+
+    // digit-wise addition for a base only known at run time
+    inline uint64_t digitadd(uint64_t a, uint64_t b, size_t num_digits, uint64_t base) {
+        switch (base) {
+            case 2: return digitadd<2>(a, b, num_digits);
+            case 3: return digitadd<3>(a, b, num_digits);
+            case 4: return digitadd<4>(a, b, num_digits);
+            case 5: return digitadd<5>(a, b, num_digits);
+            case 6: return digitadd<6>(a, b, num_digits);
+            case 7: return digitadd<7>(a, b, num_digits);
+            case 8: return digitadd<8>(a, b, num_digits);
+        }
+        uint64_t result = 0;
+        uint64_t p = 1;
+        for (size_t i = 0; i < num_digits; i++) {
+            result += (a % base + b % base) % base * p;
+            a /= base;
+            b /= base;
+            p *= base;
+        }
+        return result;
+    }
+
+    // A table of num_buckets = num_blocks * block_size buckets, block_size = base^k.
+    // The candidates of an item are its index plus multiples of a tag-derived offset,
+    // added digit-wise inside the block of the index, so they form a cyclic group of
+    // order base and any candidate recovers the others.
+    struct TableGeometry {
+        size_t base;
+        size_t num_buckets;
+        size_t block_size;
+        size_t num_blocks;
+        size_t block_digits;
+
+        TableGeometry(): base(0), num_buckets(0), block_size(1), num_blocks(0), block_digits(0) {}
+
+        TableGeometry(size_t b, size_t block, size_t blocks):
+            base(b), num_buckets(block * blocks), block_size(block), num_blocks(blocks),
+            block_digits(numdigits(block, b)) {}
+
+        // one block of the smallest power of base holding min_buckets
+        static TableGeometry Power(size_t min_buckets, size_t base) {
+            return TableGeometry(base, upperpower(min_buckets, base), 1);
+        }
+
+        // Exact table sizing for max_num_keys items at load threshold. Keys
+        // spread binomially over the blocks, so every block gets 3 standard
+        // deviations of extra buckets. The block size that gives the smallest
+        // table wins; a single block is the power-of-base sizing. The result is
+        // capped at the baseline sizing, a power of base multiplied by base once
+        // if the load exceeds threshold: for d=2 that may load a table a little
+        // beyond threshold, e.g. 1e9 keys on 2^31 buckets, where the exact
+        // sizing would take 2.39e9.
+        static TableGeometry Exact(size_t max_num_keys, size_t base, double threshold) {
+            const size_t min_buckets = ceil(max_num_keys / threshold);
+            TableGeometry best;
+            for (uint64_t block = base; ; block *= base) {
+                size_t num_blocks = 1;
+                if (block < min_buckets) {
+                    double keys_per_block = threshold * block;
+                    double slack = 3.0 * sqrt(keys_per_block) / keys_per_block;
+                    size_t wanted = (size_t) ceil(min_buckets * (1.0 + slack));
+                    num_blocks = (wanted + block - 1) / block;
+                }
+                if (best.num_blocks == 0 || block * num_blocks < best.num_buckets) {
+                    best = TableGeometry(base, block, num_blocks);
+                }
+                if (block >= min_buckets || block > UINT64_MAX / base) break;
+            }
+
+            uint64_t power = upperpower(max_num_keys, base);
+            if (power != 0 && (double) max_num_keys / power > threshold && power <= UINT64_MAX / base) {
+                power *= base;
+            }
+            if (power != 0 && power < best.num_buckets) {
+                best = TableGeometry(base, power, 1);
+            }
+            return best;
+        }
+
+        // Bucket of a 64-bit item hash. Tables of up to 2^32 buckets take the
+        // high 32 bits, the low ones being left to the tag. Larger tables need
+        // more bits and take the whole hash, remixed so the index does not
+        // follow the tag bits.
+        inline size_t Index(const uint64_t hv) const {
+            if (num_buckets <= (1ULL << 32)) return (uint32_t) (hv >> 32) % num_buckets;
+            return mix64(hv) % num_buckets;
+        }
+
+        // the candidate following index for an item whose tag hashes to hv
+        template <size_t d>
+        inline size_t AltIndex(const size_t index, const uint64_t hv) const {
+            const size_t start = index - index % block_size;
+            return start + digitadd<d>(hv % block_size, index - start, block_digits);
+        }
+    };
+}
+
+#endif // #ifndef _GEOMETRY_H_
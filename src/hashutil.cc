@@ -553,14 +553,14 @@ namespace d_ary_cuckoofilter {
 
     std::string HashUtil::MD5Hash(const char* inbuf, size_t in_length)
     {
-        EVP_MD_CTX mdctx;
+        EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
         unsigned char md_value[EVP_MAX_MD_SIZE];
         unsigned int md_len;
 
-        EVP_DigestInit(&mdctx, EVP_md5());
-        EVP_DigestUpdate(&mdctx, (const void*) inbuf, in_length);
-        EVP_DigestFinal_ex(&mdctx, md_value, &md_len);
-        EVP_MD_CTX_cleanup(&mdctx);
+        EVP_DigestInit_ex(mdctx, EVP_md5(), NULL);
+        EVP_DigestUpdate(mdctx, (const void*) inbuf, in_length);
+        EVP_DigestFinal_ex(mdctx, md_value, &md_len);
+        EVP_MD_CTX_free(mdctx);
 
         return std::string((char*)md_value, (size_t)md_len);
     }
@@ -568,15 +568,15 @@ namespace d_ary_cuckoofilter {
 
     std::string HashUtil::SHA1Hash(const char* inbuf, size_t in_length)
     {
-        EVP_MD_CTX mdctx;
+        EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
         std::string ret;
         unsigned char md_value[EVP_MAX_MD_SIZE];
         unsigned int md_len;
 
-        EVP_DigestInit(&mdctx, EVP_sha1());
-        EVP_DigestUpdate(&mdctx, (const void*) inbuf, in_length);
-        EVP_DigestFinal_ex(&mdctx, md_value, &md_len);
-        EVP_MD_CTX_cleanup(&mdctx);
+        EVP_DigestInit_ex(mdctx, EVP_sha1(), NULL);
+        EVP_DigestUpdate(mdctx, (const void*) inbuf, in_length);
+        EVP_DigestFinal_ex(mdctx, md_value, &md_len);
+        EVP_MD_CTX_free(mdctx);
 
         return std::string((char*)md_value, (size_t)md_len);
     }
@@ -6,6 +6,7 @@
 #include <string>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <openssl/evp.h>
 
 
@@ -42,6 +43,47 @@ namespace d_ary_cuckoofilter {
     private:
         HashUtil();
     };
+
+    // SHA1 over a key given in any number of pieces, without copying or allocating.
+    // Final64 gives the first 64 bits of the digest, the same bits a one-shot
+    // SHA1Hash of the concatenated pieces starts with, and starts over for the
+    // next key. Setting up a context costs more than hashing a short key, so
+    // callers keep a stream around, e.g. one per thread.
+    class SHA1Stream {
+    public:
+        SHA1Stream(): ctx_(EVP_MD_CTX_new()) { EVP_DigestInit_ex(ctx_, Digest(), NULL); }
+
+        ~SHA1Stream() { EVP_MD_CTX_free(ctx_); }
+
+        SHA1Stream(const SHA1Stream&) = delete;
+        SHA1Stream& operator=(const SHA1Stream&) = delete;
+
+        void Update(const void *buf, size_t length) { EVP_DigestUpdate(ctx_, buf, length); }
+
+        uint64_t Final64() {
+            unsigned char md_value[EVP_MAX_MD_SIZE];
+            unsigned int md_len;
+            uint64_t hv;
+            EVP_DigestFinal_ex(ctx_, md_value, &md_len);
+            EVP_DigestInit_ex(ctx_, Digest(), NULL);
+            memcpy(&hv, md_value, sizeof(hv));
+            return hv;
+        }
+
+    private:
+        // OpenSSL 3 looks EVP_sha1() up again on every init, a fetched digest
+        // is looked up once
+        static const EVP_MD* Digest() {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+            static EVP_MD* md = EVP_MD_fetch(NULL, "SHA1", NULL);
+            return md;
+#else
+            return EVP_sha1();
+#endif
+        }
+
+        EVP_MD_CTX *ctx_;
+    };
 }
 
 #endif  // #ifndef _HASHUTIL_H_
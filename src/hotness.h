@@ -0,0 +1,127 @@
+// HotnessSketch counts, on a sample of lookups, how often items were found
+// past their first candidate. It is a small count-min sketch kept outside the
+// table; items whose count crosses a threshold are queued for promotion.
+#ifndef _HOTNESS_H_
+#define _HOTNESS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+namespace d_ary_cuckoofilter {
+
+    class HotnessSketch {
+    public:
+        // an item by its index and tag
+        struct Item {
+            uint64_t index;
+            uint32_t tag;
+        };
+
+    private:
+        static constexpr size_t kDepth = 2;
+
+        struct HotSlot {
+            std::atomic<uint64_t> index;
+            std::atomic<uint32_t> tag;
+        };
+
+        // kDepth rows of saturating 8-bit counters
+        std::vector<std::atomic<uint8_t> > counters_;
+        size_t width_mask_;
+
+        // one lookup in 2^sample_shift is counted
+        uint32_t sample_mask_;
+        uint8_t threshold_;
+
+        // items that crossed the threshold, the oldest overwritten first. Index
+        // and tag are written apart, so a racing reader may see a torn item;
+        // the table is checked before anything moves.
+        std::vector<HotSlot> hot_;
+        std::atomic<size_t> hot_next_;
+
+        static inline uint64_t Mix(uint64_t x) {
+            x ^= x >> 33;
+            x *= 0xff51afd7ed558ccdULL;
+            x ^= x >> 33;
+            return x;
+        }
+
+        static inline uint32_t NextRandom() {
+            static thread_local uint32_t state = 2463534242U;
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return state;
+        }
+
+        inline std::atomic<uint8_t>& Counter(size_t row, uint64_t h) {
+            return counters_[row * (width_mask_ + 1) + ((h >> (row * 32)) & width_mask_)];
+        }
+
+    public:
+        // width is rounded up to a power of 2
+        explicit HotnessSketch(size_t width = 1 << 16, uint32_t sample_shift = 4,
+                               uint8_t threshold = 4, size_t hot_capacity = 1024):
+            sample_mask_((1U << sample_shift) - 1), threshold_(threshold),
+            hot_(hot_capacity), hot_next_(0) {
+            for (size_t k = 0; k < hot_.size(); k++) hot_[k].tag.store(0, std::memory_order_relaxed);
+            size_t w = 1;
+            while (w < width) w <<= 1;
+            width_mask_ = w - 1;
+            counters_ = std::vector<std::atomic<uint8_t> >(kDepth * w);
+        }
+
+        // Count a lookup of an item, tags are never 0. Lookups run concurrently,
+        // so the counters are updated without read-modify-write and may lose a
+        // few counts.
+        inline void Record(const uint64_t index, const uint32_t tag) {
+            if (NextRandom() & sample_mask_) return;
+            const uint64_t h = Mix(index * 0x9E3779B97F4A7C15ULL + tag);
+            uint8_t estimate = 255;
+            for (size_t r = 0; r < kDepth; r++) {
+                std::atomic<uint8_t>& c = Counter(r, h);
+                uint8_t v = c.load(std::memory_order_relaxed);
+                if (v < 255) c.store(++v, std::memory_order_relaxed);
+                if (v < estimate) estimate = v;
+            }
+            if (estimate == threshold_) {
+                HotSlot& slot = hot_[hot_next_.fetch_add(1, std::memory_order_relaxed) % hot_.size()];
+                slot.index.store(index, std::memory_order_relaxed);
+                slot.tag.store(tag, std::memory_order_relaxed);
+            }
+        }
+
+        uint8_t Estimate(const uint64_t index, const uint32_t tag) {
+            const uint64_t h = Mix(index * 0x9E3779B97F4A7C15ULL + tag);
+            uint8_t estimate = 255;
+            for (size_t r = 0; r < kDepth; r++) {
+                uint8_t v = Counter(r, h).load(std::memory_order_relaxed);
+                if (v < estimate) estimate = v;
+            }
+            return estimate;
+        }
+
+        // append the queued hot items to items and empty the queue
+        void TakeHot(std::vector<Item>* items) {
+            for (size_t k = 0; k < hot_.size(); k++) {
+                Item item;
+                item.tag = hot_[k].tag.exchange(0, std::memory_order_relaxed);
+                if (!item.tag) continue;
+                item.index = hot_[k].index.load(std::memory_order_relaxed);
+                items->push_back(item);
+            }
+        }
+
+        // halve every counter so that old lookups fade out
+        void Age() {
+            for (size_t k = 0; k < counters_.size(); k++) {
+                counters_[k].store(counters_[k].load(std::memory_order_relaxed) >> 1,
+                                   std::memory_order_relaxed);
+            }
+        }
+    };
+}
+
+#endif // #ifndef _HOTNESS_H_
@@ -0,0 +1,136 @@
+// InterleavedLookup keeps a stream of Contain queries in flight to hide memory
+// latency. Every lookup is a small state machine that prefetches its next
+// candidate bucket and yields; a round-robin scheduler steps kInFlight of them,
+// so by the time a lookup is stepped again its bucket is usually in cache.
+// Results are delivered to a callback, or queued for PopCompletion without one.
+#ifndef _INTERLEAVED_LOOKUP_H_
+#define _INTERLEAVED_LOOKUP_H_
+
+#include "d_ary_cuckoofilter.h"
+
+#include <functional>
+#include <vector>
+
+namespace d_ary_cuckoofilter {
+
+    template <typename FilterType, size_t kInFlight = 16>
+    class InterleavedLookup {
+    public:
+        typedef std::function<void(uint64_t cookie, Status status)> Callback;
+
+    private:
+        struct Slot {
+            typename FilterType::LookupState state;
+            uint64_t cookie;
+            bool busy;
+        };
+
+        struct Completion {
+            uint64_t cookie;
+            Status status;
+        };
+
+        const FilterType& filter_;
+        Callback callback_;
+
+        Slot slots_[kInFlight];
+        size_t num_busy_;
+        // next slot the scheduler looks at
+        size_t cursor_;
+
+        // completion ring used when there is no callback
+        std::vector<Completion> ring_;
+        size_t ring_head_;
+        size_t ring_size_;
+
+        void Complete(uint64_t cookie, Status status) {
+            if (callback_) {
+                callback_(cookie, status);
+                return;
+            }
+            if (ring_size_ == ring_.size()) {
+                // grow, keeping the queued completions in order
+                std::vector<Completion> bigger(ring_.size() * 2);
+                for (size_t k = 0; k < ring_size_; k++) {
+                    bigger[k] = ring_[(ring_head_ + k) % ring_.size()];
+                }
+                ring_.swap(bigger);
+                ring_head_ = 0;
+            }
+            Completion& c = ring_[(ring_head_ + ring_size_) % ring_.size()];
+            c.cookie = cookie;
+            c.status = status;
+            ring_size_++;
+        }
+
+        // step the lookup in slot k; returns true if it finished
+        bool Step(size_t k) {
+            Status status;
+            if (!filter_.LookupStep(&slots_[k].state, &status)) {
+                return false;
+            }
+            slots_[k].busy = false;
+            num_busy_--;
+            Complete(slots_[k].cookie, status);
+            return true;
+        }
+
+    public:
+        explicit InterleavedLookup(const FilterType& filter, Callback callback = Callback()):
+            filter_(filter), callback_(callback), num_busy_(0), cursor_(0),
+            ring_(2 * kInFlight), ring_head_(0), ring_size_(0) {
+            for (size_t k = 0; k < kInFlight; k++) slots_[k].busy = false;
+        }
+
+        // Start a lookup of a pre-hashed item. With every slot busy, in-flight
+        // lookups are stepped round-robin until one finishes.
+        void SubmitHash(const uint64_t hv, const uint64_t cookie) {
+            while (num_busy_ == kInFlight) {
+                Step(cursor_);
+                cursor_ = (cursor_ + 1) % kInFlight;
+            }
+            while (slots_[cursor_].busy) {
+                cursor_ = (cursor_ + 1) % kInFlight;
+            }
+            Slot& slot = slots_[cursor_];
+            filter_.LookupBegin(hv, &slot.state);
+            slot.cookie = cookie;
+            slot.busy = true;
+            num_busy_++;
+            cursor_ = (cursor_ + 1) % kInFlight;
+        }
+
+        template <typename ItemType>
+        void Submit(const ItemType& item, const uint64_t cookie) {
+            SubmitHash(FilterType::Hash(item), cookie);
+        }
+
+        // step every in-flight lookup once; returns the number still in flight
+        size_t Poll() {
+            for (size_t k = 0; k < kInFlight; k++) {
+                if (slots_[k].busy) Step(k);
+            }
+            return num_busy_;
+        }
+
+        // finish every in-flight lookup
+        void Drain() {
+            while (Poll()) {}
+        }
+
+        size_t InFlight() const { return num_busy_; }
+
+        // take the oldest queued completion; false if there is none
+        bool PopCompletion(uint64_t* cookie, Status* status) {
+            if (ring_size_ == 0) return false;
+            const Completion& c = ring_[ring_head_];
+            *cookie = c.cookie;
+            *status = c.status;
+            ring_head_ = (ring_head_ + 1) % ring_.size();
+            ring_size_--;
+            return true;
+        }
+    };
+}  // namespace d_ary_cuckoofilter
+
+#endif // #ifndef _INTERLEAVED_LOOKUP_H_
@@ -0,0 +1,43 @@
+// KeyTraits tells the filter which bytes of an item to hash.
+// Fixed-size items are hashed as their object representation; strings and
+// string views are hashed by content, so a std::string key and a
+// std::string_view over the same bytes land on the same tag and index.
+// Specialize KeyTraits to feed composite keys piece by piece.
+#ifndef _KEY_TRAITS_H_
+#define _KEY_TRAITS_H_
+
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "hashutil.h"
+
+namespace d_ary_cuckoofilter {
+
+    template <typename ItemType>
+    struct KeyTraits {
+        static_assert(std::is_trivially_copyable<ItemType>::value,
+                      "hashing an item with indirections hashes its pointers; "
+                      "specialize KeyTraits for it");
+
+        static void Update(const ItemType& item, SHA1Stream* h) {
+            h->Update(&item, sizeof(item));
+        }
+    };
+
+    template <>
+    struct KeyTraits<std::string_view> {
+        static void Update(const std::string_view& item, SHA1Stream* h) {
+            h->Update(item.data(), item.size());
+        }
+    };
+
+    template <>
+    struct KeyTraits<std::string> {
+        static void Update(const std::string& item, SHA1Stream* h) {
+            h->Update(item.data(), item.size());
+        }
+    };
+}
+
+#endif // #ifndef _KEY_TRAITS_H_
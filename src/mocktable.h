@@ -9,6 +9,7 @@
 #include <assert.h>
 
 #include "bitsutil.h"
+#include "dirtypages.h"
 #include "debug.h"
 
 
@@ -17,67 +18,90 @@ namespace d_ary_cuckoofilter {
     template <size_t bits_per_tag> //any size is OK
     class MockTable {
         
+        static_assert(bits_per_tag >= 1 && bits_per_tag <= 32,
+                      "MockTable stores tags of 1 to 32 bits");
+        
         struct Bucket {
             uint32_t bits_;
         };
         
         size_t num_buckets;
         
+        // AltIndex stays inside the blocks of the geometry
+        TableGeometry geometry_;
+        
         Bucket *buckets_;
         
+        // pages written since the last delta, NULL unless tracking is enabled
+        DirtyPages *dirty_;
+        
     public:
         static const uint32_t TAGMASK = (1ULL << bits_per_tag) - 1;
         
+        static double LoadThreshold(size_t num_candidate_buckets) {
+            return loadthreshold(num_candidate_buckets);
+        }
+        
+        // layout of the table holding max_num_keys items
+        static TableGeometry Geometry(size_t num_candidate_buckets, size_t max_num_keys) {
+            if (num_candidate_buckets < 2 || num_candidate_buckets > 8) {
+                return TableGeometry();
+            }
+            return TableGeometry::Exact(max_num_keys, num_candidate_buckets,
+                                        LoadThreshold(num_candidate_buckets));
+        }
+        
+        // number of buckets allocated for max_num_keys items
+        static size_t NumBuckets(size_t num_candidate_buckets, size_t max_num_keys) {
+            return Geometry(num_candidate_buckets, max_num_keys).num_buckets;
+        }
+        
         explicit
         MockTable(size_t num_candidate_buckets, size_t max_num_keys) {
-            switch (num_candidate_buckets) {
-                case 2:
-                    num_buckets = upperpower2(max_num_keys);
-                    break;
-                case 3:
-                    num_buckets = upperpower3(max_num_keys);
-                    break;
-                case 4:
-                    num_buckets = upperpower4(max_num_keys);
-                    break;
-                case 5:
-                    num_buckets = upperpower5(max_num_keys);
-                    break;
-                default:
-                    break;
-            }
-            double frac = (double) max_num_keys / num_buckets;
-            switch (num_candidate_buckets) {
-                case 2:
-                    if (frac > 0.42) num_buckets <<= 1; break;
-                case 3:
-                    if (frac > 0.91) num_buckets *= 3;  break;
-                case 4:
-                    if (frac > 0.97) num_buckets *= 4;  break;
-                case 5:
-                    if (frac > 0.985) num_buckets *= 5; break;
-            }
+            geometry_ = Geometry(num_candidate_buckets, max_num_keys);
+            num_buckets = geometry_.num_buckets;
             buckets_ = new Bucket[num_buckets];
+            dirty_ = NULL;
             CleanupTags();
         }
         
         ~MockTable() {
             delete [] buckets_;
+            delete dirty_;
         }
         
-        void CleanupTags() { memset(buckets_, 0,  num_buckets); }
+        void CleanupTags() { memset(buckets_, 0, sizeof(Bucket) * num_buckets); }
         
         size_t SizeInBits() const { return bits_per_tag * num_buckets; }
         
+        size_t SizeInBytes() const { return sizeof(Bucket) * num_buckets; }
+        
         size_t SizeInBuckets() const { return num_buckets; }
         
+        // the table as raw bytes, for snapshots and deltas
+        char* RawBytes() { return (char*) buckets_; }
+        
+        const char* RawBytes() const { return (const char*) buckets_; }
+        
+        // start recording written pages, all pages clean
+        void EnableDirtyTracking() {
+            if (!dirty_) dirty_ = new DirtyPages(SizeInBytes());
+        }
+        
+        DirtyPages* Dirty() { return dirty_; }
+        
         size_t HashTableSize() const { return num_buckets; }
         
+        size_t BlockSize() const { return geometry_.block_size; }
+        
+        const TableGeometry& Geometry() const { return geometry_; }
+        
         
         std::string Info() const  {
             std::stringstream ss;
             ss << "\t\tMockHashTable with tag size: " << bits_per_tag << " bits \n";
             ss << "\t\tTotal rows: " << num_buckets << "\n";
+            ss << "\t\tBlock size: " << geometry_.block_size << "\n";
             ss << "\t\tTable size in bits: " << SizeInBuckets() * bits_per_tag << "\n";
             return ss.str();
         }
@@ -88,11 +112,26 @@ namespace d_ary_cuckoofilter {
         }
         
         
+        // tags of this table are always stored under their own slot
+        inline uint32_t ReadMark(const size_t) const {
+            return 0;
+        }
+        
         inline void  WriteTag(const size_t i, const uint32_t t) {
             buckets_[i].bits_ = t & TAGMASK;
+            if (dirty_) dirty_->Mark(i * sizeof(Bucket));
             return;
         }
         
+        inline void PrefetchBucket(const size_t i) const {
+            _mm_prefetch((const char*) &buckets_[i], _MM_HINT_T0);
+        }
+        
+        // index the tag stored in slot i was placed under
+        inline size_t IndexOfSlot(const size_t i) const {
+            return i;
+        }
+        
         inline bool  FindTagInBucket(const size_t i,  const uint32_t tag) const {
             if (ReadTag(i) == tag)
                 return true;
@@ -8,6 +8,7 @@
 #include <assert.h>
 
 #include "bitsutil.h"
+#include "dirtypages.h"
 #include "debug.h"
 
 
@@ -18,6 +19,9 @@ namespace d_ary_cuckoofilter {
     template <size_t bits_per_tag> //any size is OK
     class PackedTable {
         
+        static_assert(bits_per_tag >= 1 && bits_per_tag <= 32,
+                      "PackedTable stores tags of 1 to 32 bits");
+        
         struct Bucket {
             uint32_t bits_;
             uint32_t mark;
@@ -27,57 +31,75 @@ namespace d_ary_cuckoofilter {
         size_t mocktablesize;
         size_t num_candidate_buckets;
         
+        // the whole mock table is a single block
+        TableGeometry geometry_;
+        
         // using a pointer adds one more indirection
         Bucket *buckets_;
         
+        // pages written since the last delta, NULL unless tracking is enabled
+        DirtyPages *dirty_;
+        
     public:
         static const uint32_t TAGMASK = (1ULL << bits_per_tag) - 1;
         
+        // PackedTable keeps a slightly lower threshold for 4-ary tables
+        static double LoadThreshold(size_t num_candidate_buckets) {
+            if (num_candidate_buckets == 4) return 0.96;
+            return loadthreshold(num_candidate_buckets);
+        }
+        
+        // number of buckets allocated for max_num_keys items
+        static size_t NumBuckets(size_t num_candidate_buckets, size_t max_num_keys) {
+            return ceil(max_num_keys / LoadThreshold(num_candidate_buckets));
+        }
+        
         explicit
         PackedTable(size_t num, size_t max_num_keys) {
             
             num_candidate_buckets = num;
             
-            switch (num_candidate_buckets) {
-                case 2:
-                    mocktablesize = upperpower2(max_num_keys);
-                    break;
-                case 3:
-                    mocktablesize = upperpower3(max_num_keys);
-                    break;
-                case 4:
-                    mocktablesize = upperpower4(max_num_keys);
-                    break;
-                case 5:
-                    mocktablesize = upperpower5(max_num_keys);
-                    break;
-                default:
-                    std::cout << "the valid candidate bucket num is 2~5";
-            }
-            switch (num_candidate_buckets) {
-                case 2:
-                    num_buckets = ceil(max_num_keys / 0.42); break;
-                case 3:
-                    num_buckets = ceil(max_num_keys / 0.91); break;
-                case 4:
-                    num_buckets = ceil(max_num_keys / 0.96); break;
-                case 5:
-                    num_buckets = ceil(max_num_keys / 0.985); break;
+            if (num_candidate_buckets < 2 || num_candidate_buckets > 8) {
+                std::cout << "the valid candidate bucket num is 2~8";
             }
+            mocktablesize = upperpower(max_num_keys, num_candidate_buckets);
+            geometry_ = TableGeometry(num_candidate_buckets, mocktablesize, 1);
+            num_buckets = NumBuckets(num_candidate_buckets, max_num_keys);
             buckets_ = new Bucket[num_buckets];
+            dirty_ = NULL;
             CleanupTags();
         }
         
         ~PackedTable() {
             delete [] buckets_;
+            delete dirty_;
         }
         
-        void CleanupTags() { memset(buckets_, 0,  num_buckets); }
+        void CleanupTags() { memset(buckets_, 0, sizeof(Bucket) * num_buckets); }
+        
+        size_t SizeInBytes() const { return sizeof(Bucket) * num_buckets; }
         
         size_t SizeInBuckets() const { return num_buckets; }
         
+        // the table as raw bytes, for snapshots and deltas
+        char* RawBytes() { return (char*) buckets_; }
+        
+        const char* RawBytes() const { return (const char*) buckets_; }
+        
+        // start recording written pages, all pages clean
+        void EnableDirtyTracking() {
+            if (!dirty_) dirty_ = new DirtyPages(SizeInBytes());
+        }
+        
+        DirtyPages* Dirty() { return dirty_; }
+        
         size_t HashTableSize() const { return mocktablesize; }
         
+        // candidates are computed over the whole power-of-d mock table
+        size_t BlockSize() const { return mocktablesize; }
+        
+        const TableGeometry& Geometry() const { return geometry_; }
+        
         std::string Info() const  {
             std::stringstream ss;
             ss << "\t\tPackedHashTable with tag size: " << bits_per_tag << " bits \n";
@@ -100,9 +122,19 @@ namespace d_ary_cuckoofilter {
         inline void  WriteTag(const size_t i, const uint32_t t) {
             buckets_[i % num_buckets].bits_ = t & TAGMASK;
             buckets_[i % num_buckets].mark = i / num_buckets;
+            if (dirty_) dirty_->Mark((i % num_buckets) * sizeof(Bucket));
             return;
         }
         
+        inline void PrefetchBucket(const size_t i) const {
+            _mm_prefetch((const char*) &buckets_[i % num_buckets], _MM_HINT_T0);
+        }
+        
+        // index the tag stored in slot i was placed under, recovered from its mark
+        inline size_t IndexOfSlot(const size_t i) const {
+            return i + ReadMark(i) * num_buckets;
+        }
+        
         inline bool  FindTagInBucket(const size_t i,  const uint32_t tag) const {
             if (ReadTag(i) == tag && ReadMark(i) == (i/num_buckets))
                 return true;
@@ -0,0 +1,486 @@
+// PersistentCuckooFilter is a DaryCuckooFilter that survives restarts. Every
+// Add and Delete appends a record to a write-ahead log, and Checkpoint writes
+// the whole table, the item count and the victim as a FilterDelta. Opening a
+// filter loads the latest checkpoint and replays the log records after it.
+// Both files keep the seed of the random walk of Add at their first record,
+// so replay places every tag, and the victim, where the live filter did.
+//
+// Records are written and synced by a background thread in groups, so Add costs
+// about as much as an in-memory Add; a crash loses at most the records of the
+// last group_commit_us microseconds. Sync waits for everything added so far.
+#ifndef _PERSISTENT_CUCKOO_FILTER_H_
+#define _PERSISTENT_CUCKOO_FILTER_H_
+
+#include "d_ary_cuckoofilter.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace d_ary_cuckoofilter {
+
+    // One log record. Records are numbered from the start of the log, and the
+    // check covers the number too, so a torn write at the end of the log and
+    // stale bytes past it are both rejected.
+    struct WalRecord {
+        enum Op : uint32_t {
+            kAdd = 1,
+            kDelete = 2,
+        };
+
+        uint64_t hv;
+        uint32_t op;
+        uint32_t check;
+
+        static uint32_t Check(const uint64_t hv, const uint32_t op, const uint64_t lsn) {
+            return (uint32_t) mix64(hv ^ mix64(((uint64_t) op << 56) ^ lsn));
+        }
+    };
+
+    // first bytes of the log and checkpoint files
+    struct WalFileHeader {
+        static constexpr uint32_t kWalMagic = 0x44435741;        // "DCWA"
+        static constexpr uint32_t kCheckpointMagic = 0x4443434b; // "DCCK"
+
+        uint32_t magic;
+        uint32_t bits_per_item;
+        uint64_t num_candidate_buckets;
+        // number of the first record of the log; for a checkpoint, of the
+        // first record it does not contain
+        uint64_t lsn;
+        // seed of the random walk of Add before record lsn
+        uint64_t seed;
+    };
+
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets>
+    class PersistentCuckooFilter {
+        typedef DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, SingleTable> Filter;
+
+        // a group is written early once this many bytes are waiting
+        static const size_t kGroupBytes = 1 << 20;
+
+        Filter filter_;
+
+        const std::string log_path_;
+        const std::string checkpoint_path_;
+        const std::chrono::microseconds group_commit_;
+
+        int log_fd_;
+
+        // number of the next record appended
+        uint64_t next_lsn_;
+
+        // guards pending_, handed_lsn_, durable_lsn_, error_ and stop_
+        std::mutex mutex_;
+        std::condition_variable flush_cv_;
+        std::condition_variable durable_cv_;
+
+        // records not yet handed to the flusher
+        std::string pending_;
+
+        // every record before handed_lsn_ left pending_, every record before
+        // durable_lsn_ is on disk
+        uint64_t handed_lsn_;
+        uint64_t durable_lsn_;
+
+        // sticky, set when a write or sync of the log fails
+        bool error_;
+
+        bool stop_;
+
+        // held while a group is taken from pending_ and written, so groups
+        // reach the log in order, and while Checkpoint replaces the log. Taken
+        // before mutex_.
+        std::mutex io_mutex_;
+
+        std::thread flusher_;
+
+        // buffer a record for the flusher; false once the log failed, and then
+        // nothing is buffered
+        bool Append(const uint64_t hv, const WalRecord::Op op);
+
+        void FlushLoop();
+
+        // write and sync the records of pending_, true on success; called and
+        // returns with lock held
+        bool FlushPending(std::unique_lock<std::mutex>& lock);
+
+        Status Recover();
+
+        static bool WriteAll(int fd, const char* data, size_t n);
+
+        static bool ReadFile(const std::string& path, std::string* out);
+
+        // durably replace path with a file of header and body
+        static bool WriteFileAtomic(const std::string& path, const WalFileHeader& header,
+                                    const std::string& body);
+
+        WalFileHeader Header(const uint32_t magic, const uint64_t lsn) const {
+            WalFileHeader header;
+            memset(&header, 0, sizeof(header));
+            header.magic = magic;
+            header.bits_per_item = bits_per_item;
+            header.num_candidate_buckets = num_candidate_buckets;
+            header.lsn = lsn;
+            header.seed = filter_.Seed();
+            return header;
+        }
+
+    public:
+        // The filter is stored in path.checkpoint and path.wal. max_num_keys must
+        // be the same every time a filter is opened.
+        PersistentCuckooFilter(const std::string& path, const size_t max_num_keys,
+                               const size_t group_commit_us = 1000):
+            filter_(max_num_keys), log_path_(path + ".wal"), checkpoint_path_(path + ".checkpoint"),
+            group_commit_(group_commit_us), log_fd_(-1), next_lsn_(0), handed_lsn_(0), durable_lsn_(0),
+            error_(false), stop_(false) {}
+
+        // syncs the records added so far
+        ~PersistentCuckooFilter();
+
+        // Recover the filter from its files, or start an empty one if there are
+        // none. NotSupported if the files belong to a filter of another type or
+        // size, or a logged change fails to replay; IOError if they cannot be
+        // read or created.
+        Status Open();
+
+        // Add and Delete return IOError once a write or sync of the log failed.
+        // The change of that call is made in memory only, and the filter has
+        // to be opened again to get back to the state on disk.
+        Status Add(const ItemType& item) { return AddHash(Filter::Hash(item)); }
+
+        Status Contain(const ItemType& item) const { return filter_.Contain(item); }
+
+        Status Delete(const ItemType& item) { return DeleteHash(Filter::Hash(item)); }
+
+        Status AddHash(const uint64_t hv);
+
+        Status ContainHash(const uint64_t hv) const { return filter_.ContainHash(hv); }
+
+        Status DeleteHash(const uint64_t hv);
+
+        // wait until every record appended so far is on disk
+        Status Sync();
+
+        // Write the filter to path.checkpoint and start an empty log. Recovery
+        // time is the time to load a checkpoint plus to replay the log after
+        // it, so callers checkpoint every few million records.
+        Status Checkpoint();
+
+        // records appended since the log was started
+        uint64_t NumRecords() const { return next_lsn_; }
+
+        size_t Size() const { return filter_.Size(); }
+
+        size_t SizeInBytes() const { return filter_.SizeInBytes(); }
+
+        double LoadFactor() const { return filter_.LoadFactor(); }
+
+        std::string Info() const { return filter_.Info(); }
+    };
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    PersistentCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::~PersistentCuckooFilter() {
+        if (flusher_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            flush_cv_.notify_one();
+            flusher_.join();
+        }
+        if (log_fd_ >= 0) close(log_fd_);
+    }
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    bool
+    PersistentCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::WriteAll(int fd, const char* data,
+                                                                                     size_t n) {
+        while (n > 0) {
+            ssize_t written = write(fd, data, n);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                DEBUG_PERROR("write");
+                return false;
+            }
+            data += written;
+            n -= written;
+        }
+        return true;
+    }
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    bool
+    PersistentCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::ReadFile(const std::string& path,
+                                                                                     std::string* out) {
+        out->clear();
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        char buf[1 << 16];
+        while (true) {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                close(fd);
+                return n == 0;
+            }
+            out->append(buf, n);
+        }
+    }
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    bool
+    PersistentCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::WriteFileAtomic(
+            const std::string& path, const WalFileHeader& header, const std::string& body) {
+        const std::string tmp = path + ".tmp";
+        int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        bool ok = WriteAll(fd, (const char*) &header, sizeof(header)) &&
+                  WriteAll(fd, body.data(), body.size()) && fsync(fd) == 0;
+        close(fd);
+        if (!ok || rename(tmp.c_str(), path.c_str()) != 0) return false;
+
+        // make the rename itself durable
+        const size_t slash = path.rfind('/');
+        const std::string dir = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+        int dir_fd = open(dir.c_str(), O_RDONLY);
+        if (dir_fd < 0) return false;
+        ok = fsync(dir_fd) == 0;
+        close(dir_fd);
+        return ok;
+    }
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    Status
+    PersistentCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Recover() {
+        std::string data;
+
+        // the checkpoint, if any
+        uint64_t checkpoint_lsn = 0;
+        if (ReadFile(checkpoint_path_, &data)) {
+            WalFileHeader header;
+            FilterDelta snapshot;
+            if (data.size() < sizeof(header)) return NotSupported;
+            memcpy(&header, data.data(), sizeof(header));
+            if (header.magic != WalFileHeader::kCheckpointMagic ||
+                header.bits_per_item != bits_per_item ||
+                header.num_candidate_buckets != num_candidate_buckets ||
+                !snapshot.Deserialize(data.substr(sizeof(header))) ||
+                filter_.ApplyDelta(snapshot) != Ok) {
+                return NotSupported;
+            }
+            checkpoint_lsn = header.lsn;
+            filter_.SetSeed((unsigned int) header.seed);
+        } else if (errno != ENOENT) {
+            return IOError;
+        }
+
+        // replay the log after the checkpoint, up to the first bad record
+        next_lsn_ = checkpoint_lsn;
+        size_t valid_bytes = 0;
+        if (ReadFile(log_path_, &data)) {
+            WalFileHeader header;
+            if (data.size() < sizeof(header)) return NotSupported;
+            memcpy(&header, data.data(), sizeof(header));
+            if (header.magic != WalFileHeader::kWalMagic ||
+                header.bits_per_item != bits_per_item ||
+                header.num_candidate_buckets != num_candidate_buckets ||
+                header.lsn > checkpoint_lsn) {
+                return NotSupported;
+            }
+            if (header.lsn == checkpoint_lsn) {
+                filter_.SetSeed((unsigned int) header.seed);
+            }
+            valid_bytes = sizeof(header);
+            uint64_t lsn = header.lsn;
+            for (size_t pos = sizeof(header); pos + sizeof(WalRecord) <= data.size();
+                 pos += sizeof(WalRecord), lsn++) {
+                WalRecord record;
+                memcpy(&record, data.data() + pos, sizeof(record));
+                if (record.check != WalRecord::Check(record.hv, record.op, lsn)) break;
+                valid_bytes = pos + sizeof(WalRecord);
+                if (lsn < checkpoint_lsn) continue;
+                // every logged change succeeded, and does so again unless the
+                // filter is not the one that wrote the log
+                Status status = record.op == WalRecord::kAdd ? filter_.AddHash(record.hv)
+                                                             : filter_.DeleteHash(record.hv);
+                if (status != Ok) return NotSupported;
+            }
+            if (lsn < checkpoint_lsn) {
+                // the log was not replaced after the checkpoint and lost records
+                // the checkpoint holds; start a new one
+                valid_bytes = 0;
+            }
+            next_lsn_ = std::max(lsn, checkpoint_lsn);
+        } else if (errno != ENOENT) {
+            return IOError;
+        }
+
+        if (valid_bytes == 0) {
+            // no log yet
+            if (!WriteFileAtomic(log_path_, Header(WalFileHeader::kWalMagic, next_lsn_), std::string())) {
+                return IOError;
+            }
+            valid_bytes = sizeof(WalFileHeader);
+        }
+        log_fd_ = open(log_path_.c_str(), O_WRONLY);
+        if (log_fd_ < 0) return IOError;
+        // new records overwrite a torn tail
+        if (ftruncate(log_fd_, valid_bytes) != 0 || lseek(log_fd_, valid_bytes, SEEK_SET) < 0) {
+            return IOError;
+        }
+        handed_lsn_ = durable_lsn_ = next_lsn_;
+        return Ok;
+    }
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    Status
+    PersistentCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Open() {
+        if (log_fd_ >= 0) return Ok;
+        Status status = Recover();
+        if (status != Ok) return status;
+        flusher_ = std::thread([this]() { FlushLoop(); });
+        return Ok;
+    }
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    inline bool
+    PersistentCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Append(const uint64_t hv,
+                                                                                   const WalRecord::Op op) {
+        WalRecord record;
+        record.hv = hv;
+        record.op = op;
+        record.check = WalRecord::Check(hv, op, next_lsn_);
+        bool full;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            // the flusher stopped writing, pending_ would only grow
+            if (error_) return false;
+            pending_.append((const char*) &record, sizeof(record));
+            full = pending_.size() >= kGroupBytes;
+        }
+        next_lsn_++;
+        if (full) flush_cv_.notify_one();
+        return true;
+    }
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    Status
+    PersistentCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::AddHash(const uint64_t hv) {
+        Status status = filter_.AddHash(hv);
+        if (status == Ok && !Append(hv, WalRecord::kAdd)) return IOError;
+        return status;
+    }
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    Status
+    PersistentCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::DeleteHash(const uint64_t hv) {
+        Status status = filter_.DeleteHash(hv);
+        if (status == Ok && !Append(hv, WalRecord::kDelete)) return IOError;
+        return status;
+    }
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    bool
+    PersistentCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::FlushPending(
+            std::unique_lock<std::mutex>& lock) {
+        lock.unlock();
+        std::unique_lock<std::mutex> io(io_mutex_);
+        lock.lock();
+        std::string group;
+        group.swap(pending_);
+        handed_lsn_ += group.size() / sizeof(WalRecord);
+        const uint64_t group_end = handed_lsn_;
+        lock.unlock();
+
+        const bool ok = group.empty() ||
+                        (WriteAll(log_fd_, group.data(), group.size()) && fdatasync(log_fd_) == 0);
+        io.unlock();
+
+        lock.lock();
+        if (ok) {
+            durable_lsn_ = std::max(durable_lsn_, group_end);
+        } else {
+            error_ = true;
+        }
+        durable_cv_.notify_all();
+        return ok;
+    }
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    void
+    PersistentCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::FlushLoop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            flush_cv_.wait_for(lock, group_commit_, [this]() {
+                return stop_ || pending_.size() >= kGroupBytes;
+            });
+            if (!pending_.empty() && !error_) {
+                FlushPending(lock);
+            }
+            if (stop_ && (pending_.empty() || error_)) return;
+        }
+    }
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    Status
+    PersistentCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Sync() {
+        if (log_fd_ < 0) return NotSupported;
+        const uint64_t target = next_lsn_;
+        std::unique_lock<std::mutex> lock(mutex_);
+        flush_cv_.notify_one();
+        durable_cv_.wait(lock, [this, target]() { return error_ || durable_lsn_ >= target; });
+        return error_ ? IOError : Ok;
+    }
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    Status
+    PersistentCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Checkpoint() {
+        if (log_fd_ < 0) return NotSupported;
+        {
+            // the filter may hold changes the log lost
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (error_) return IOError;
+        }
+
+        FilterDelta snapshot;
+        filter_.ExportSnapshot(&snapshot);
+        const uint64_t lsn = next_lsn_;
+        if (!WriteFileAtomic(checkpoint_path_, Header(WalFileHeader::kCheckpointMagic, lsn),
+                             snapshot.Serialize())) {
+            return IOError;
+        }
+
+        // The checkpoint holds every record so far, so the log starts over. A
+        // crash before the new log is in place leaves the old one, whose
+        // records recovery skips up to lsn.
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!pending_.empty() && !FlushPending(lock)) return IOError;
+        lock.unlock();
+        // nothing is appended meanwhile, Add runs on this thread
+        std::lock_guard<std::mutex> io(io_mutex_);
+        if (!WriteFileAtomic(log_path_, Header(WalFileHeader::kWalMagic, lsn), std::string())) {
+            std::lock_guard<std::mutex> relock(mutex_);
+            error_ = true;
+            return IOError;
+        }
+        int fd = open(log_path_.c_str(), O_WRONLY | O_APPEND);
+        if (fd < 0) {
+            std::lock_guard<std::mutex> relock(mutex_);
+            error_ = true;
+            return IOError;
+        }
+        close(log_fd_);
+        log_fd_ = fd;
+        return Ok;
+    }
+}  // namespace d_ary_cuckoofilter
+
+#endif // #ifndef _PERSISTENT_CUCKOO_FILTER_H_
@@ -0,0 +1,130 @@
+// RangeCuckooFilter answers "is any key in [lo, hi]" over 64-bit integer keys.
+// A key is stored with its prefixes at num_levels granularities, level l holding
+// key >> (l * bits_per_level), all in one DaryCuckooFilter. A range is covered
+// by O(num_levels * 2^bits_per_level) aligned blocks, each one prefix, and all
+// of them are probed in one batch. A block found at level l > 0 is confirmed by
+// one of its children one level down, which cuts the false positives of coarse
+// blocks.
+#ifndef _RANGE_CUCKOO_FILTER_H_
+#define _RANGE_CUCKOO_FILTER_H_
+
+#include "d_ary_cuckoofilter.h"
+
+#include <vector>
+
+namespace d_ary_cuckoofilter {
+
+    template <size_t bits_per_item,
+    size_t num_candidate_buckets,
+    size_t bits_per_level = 4,
+    size_t num_levels = 16>
+    class RangeCuckooFilter {
+        static_assert(bits_per_level >= 1 && bits_per_level * (num_levels - 1) < 64,
+                      "every level must keep some bits of the key");
+
+        typedef DaryCuckooFilter<uint64_t, bits_per_item, num_candidate_buckets, SingleTable> Filter;
+
+        static const size_t kFanout = 1 << bits_per_level;
+
+        Filter filter_;
+
+        // Number of keys added
+        size_t num_keys_;
+
+        // prefixes of different levels hash apart
+        static inline uint64_t PrefixHash(const size_t level, const uint64_t prefix) {
+            return mix64(prefix ^ (level * 0x9E3779B97F4A7C15ULL));
+        }
+
+        // true if a child of the block prefix at level is stored, looking
+        // depth levels down
+        bool Confirm(size_t level, uint64_t prefix, size_t depth) const {
+            if (level == 0 || depth == 0) return true;
+            uint64_t hvs[kFanout];
+            Status statuses[kFanout];
+            for (size_t c = 0; c < kFanout; c++) {
+                hvs[c] = PrefixHash(level - 1, (prefix << bits_per_level) | c);
+            }
+            filter_.ContainHashBatch(hvs, kFanout, statuses);
+            for (size_t c = 0; c < kFanout; c++) {
+                if (statuses[c] == Ok &&
+                    Confirm(level - 1, (prefix << bits_per_level) | c, depth - 1)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    public:
+        // Every key adds at most num_levels prefixes. Keys sharing prefixes, such
+        // as nearby timestamps or keys from a small universe, add fewer, and
+        // max_num_prefixes can size the table for that.
+        explicit RangeCuckooFilter(const size_t max_num_keys, const size_t max_num_prefixes = 0):
+            filter_(max_num_prefixes ? max_num_prefixes : max_num_keys * num_levels), num_keys_(0) {}
+
+        Status Add(const uint64_t key) {
+            // a prefix already reported present stays present, so it is not
+            // stored twice
+            for (size_t level = 0; level < num_levels; level++) {
+                const uint64_t hv = PrefixHash(level, key >> (level * bits_per_level));
+                if (filter_.ContainHash(hv) == Ok) continue;
+                Status status = filter_.AddHash(hv);
+                if (status != Ok) return status;
+            }
+            num_keys_++;
+            return Ok;
+        }
+
+        Status Contain(const uint64_t key) const {
+            return filter_.ContainHash(PrefixHash(0, key));
+        }
+
+        // Report if any key in [lo, hi] was added, with a false positive rate
+        // growing with the number of blocks covering the range
+        Status ContainRange(const uint64_t lo, const uint64_t hi) const {
+            if (lo > hi) return NotFound;
+            std::vector<size_t> levels;
+            std::vector<uint64_t> prefixes;
+            uint64_t x = lo;
+            while (true) {
+                // the largest aligned block starting at x that fits in the range
+                size_t level = 0;
+                while (level + 1 < num_levels) {
+                    const size_t shift = (level + 1) * bits_per_level;
+                    if ((x & ((1ULL << shift) - 1)) != 0) break;
+                    if (hi - x < (1ULL << shift) - 1) break;
+                    level++;
+                }
+                levels.push_back(level);
+                prefixes.push_back(x >> (level * bits_per_level));
+                const uint64_t last = x + ((1ULL << (level * bits_per_level)) - 1);
+                if (last >= hi) break;
+                x = last + 1;
+            }
+
+            std::vector<uint64_t> hvs(prefixes.size());
+            std::vector<Status> statuses(prefixes.size());
+            for (size_t k = 0; k < prefixes.size(); k++) {
+                hvs[k] = PrefixHash(levels[k], prefixes[k]);
+            }
+            filter_.ContainHashBatch(hvs.data(), hvs.size(), statuses.data());
+            for (size_t k = 0; k < prefixes.size(); k++) {
+                if (statuses[k] == Ok && Confirm(levels[k], prefixes[k], 1)) {
+                    return Ok;
+                }
+            }
+            return NotFound;
+        }
+
+        size_t Size() const { return num_keys_; }
+
+        // prefixes stored, at least one per key
+        size_t NumPrefixes() const { return filter_.Size(); }
+
+        double BitsPerKey() const { return 1.0 * filter_.SizeInBits() / Size(); }
+
+        size_t SizeInBytes() const { return filter_.SizeInBytes(); }
+    };
+}  // namespace d_ary_cuckoofilter
+
+#endif // #ifndef _RANGE_CUCKOO_FILTER_H_
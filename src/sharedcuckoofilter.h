@@ -0,0 +1,357 @@
+// SharedCuckooFilter lives entirely in a memory region provided by the caller,
+// e.g. from shm_open or memfd_create mapped MAP_SHARED, so that processes on a
+// host share one copy of a filter. The region starts with a header describing
+// the filter, followed by a SingleTable. One process writes; any number of
+// processes read. Every write is bracketed by a sequence lock in the header,
+// and readers retry a lookup that overlapped a write, so they never see an
+// item half-way through its kicks. Item count and victim are in the header
+// too, so every process sees the same filter.
+//
+// A writer that crashes inside a write leaves the sequence odd for good.
+// Readers wait on one write for kSharedReadRetries tries, spinning first and
+// then yielding, and after that take the writer for crashed: Contain returns
+// IOError, and the region has to be created again.
+#ifndef _SHARED_CUCKOO_FILTER_H_
+#define _SHARED_CUCKOO_FILTER_H_
+
+#include "d_ary_cuckoofilter.h"
+
+#include <atomic>
+#include <new>
+#include <thread>
+
+namespace d_ary_cuckoofilter {
+
+    struct SharedFilterHeader {
+        static constexpr uint32_t kMagic = 0x44435348; // "DCSH"
+        static constexpr uint32_t kLayoutVersion = 1;
+
+        // written last by Create, so a process attaching sees all of the rest
+        std::atomic<uint32_t> magic;
+        uint32_t layout_version;
+
+        // layout, checked by every process attaching
+        uint32_t bits_per_item;
+        uint32_t num_candidate_buckets;
+        uint64_t max_num_keys;
+        uint64_t num_buckets;
+        uint64_t block_size;
+        uint64_t table_offset;
+        uint64_t table_bytes;
+
+        // odd while the writer is changing the filter
+        std::atomic<uint64_t> sequence;
+
+        // filter state, written under the sequence lock
+        uint64_t num_items;
+        uint64_t victim_index;
+        uint32_t victim_tag;
+        uint32_t victim_used;
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+                  std::atomic<uint32_t>::is_always_lock_free,
+                  "the sequence lock and the magic must work across processes");
+
+    // tries a reader spins on a write in progress before it yields instead
+    const size_t kSharedReadSpins = 64;
+
+    // tries a reader waits on one write before it takes the writer for crashed,
+    // well beyond any number of kicks
+    const size_t kSharedReadRetries = 1 << 20;
+
+    template <typename ItemType,
+    size_t bits_per_item,
+    size_t num_candidate_buckets>
+    class SharedCuckooFilter {
+        static_assert(num_candidate_buckets >= 2 && num_candidate_buckets <= 8,
+                      "num_candidate_buckets must be 2 to 8");
+
+        typedef DaryCuckooFilter<ItemType, bits_per_item, num_candidate_buckets, SingleTable> Filter;
+        typedef CuckooWalk<bits_per_item, num_candidate_buckets> Walk;
+
+        // the table starts on its own cache line
+        static const size_t kTableOffset = (sizeof(SharedFilterHeader) + 63) / 64 * 64;
+
+        char *region_;
+        size_t region_bytes_;
+
+        // NULL until Create or Attach succeeded
+        SharedFilterHeader *header_;
+        SingleTable<bits_per_item> *table_;
+
+        TableGeometry geometry_;
+
+        // state of the random walk of Add, local to the writer
+        unsigned int seed_;
+
+        inline void SplitHash(const uint64_t hv, size_t* index, uint32_t* tag) const {
+            Walk::SplitHash(geometry_, hv, index, tag);
+        }
+
+        inline void Candidates(const size_t i, const uint32_t tag,
+                               size_t (&index)[num_candidate_buckets]) const {
+            Walk::Candidates(geometry_, i, tag, index);
+        }
+
+        inline bool VictimMatch(const uint32_t tag,
+                                const size_t (&index)[num_candidate_buckets]) const {
+            return header_->victim_used && tag == header_->victim_tag &&
+                   Walk::Among(header_->victim_index, index);
+        }
+
+        // writer side of the sequence lock
+        inline void BeginWrite() {
+            header_->sequence.store(header_->sequence.load(std::memory_order_relaxed) + 1,
+                                    std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+
+        inline void EndWrite() {
+            header_->sequence.store(header_->sequence.load(std::memory_order_relaxed) + 1,
+                                    std::memory_order_release);
+        }
+
+        // Reader side of the sequence lock: run read until no write overlapped
+        // it. False if the writer stayed inside one write for kSharedReadRetries
+        // tries.
+        template <typename Read>
+        bool ReadConsistent(Read&& read) const;
+
+        bool Place(const size_t i, const uint32_t tag);
+
+        bool ContainImpl(const size_t i, const uint32_t tag) const;
+
+    public:
+        static size_t RequiredBytes(const size_t max_num_keys) {
+            return kTableOffset + SingleTable<bits_per_item>::NumBytes(num_candidate_buckets, max_num_keys);
+        }
+
+        // nothing is read or written until Create or Attach
+        SharedCuckooFilter(void* region, const size_t region_bytes):
+            region_((char*) region), region_bytes_(region_bytes),
+            header_(NULL), table_(NULL), seed_(time(NULL)) {}
+
+        ~SharedCuckooFilter() {
+            delete table_;
+        }
+
+        // Lay out an empty filter for max_num_keys items in the region, as the
+        // writer. NotEnoughSpace if the region is smaller than RequiredBytes.
+        Status Create(const size_t max_num_keys);
+
+        // Use the filter another process created in the region. NotSupported if
+        // the region holds no filter or one of a different type.
+        Status Attach();
+
+        // writer only
+        Status Add(const ItemType& item);
+
+        Status Delete(const ItemType& item);
+
+        // any process; IOError if the writer crashed inside a write
+        Status Contain(const ItemType& item) const;
+
+        // the item count; if the writer crashed inside a write, the count as
+        // of then
+        size_t Size() const;
+
+        double LoadFactor() const { return 1.0 * Size() / table_->SizeInBuckets(); }
+
+        size_t SizeInBytes() const { return table_->SizeInBytes(); }
+    };
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    Status
+    SharedCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Create(const size_t max_num_keys) {
+        if (region_bytes_ < RequiredBytes(max_num_keys)) {
+            return NotEnoughSpace;
+        }
+        header_ = new (region_) SharedFilterHeader();
+        delete table_;
+        table_ = new SingleTable<bits_per_item>(num_candidate_buckets, max_num_keys, region_ + kTableOffset);
+        table_->CleanupTags();
+        geometry_ = table_->Geometry();
+
+        header_->layout_version = SharedFilterHeader::kLayoutVersion;
+        header_->bits_per_item = bits_per_item;
+        header_->num_candidate_buckets = num_candidate_buckets;
+        header_->max_num_keys = max_num_keys;
+        header_->num_buckets = geometry_.num_buckets;
+        header_->block_size = geometry_.block_size;
+        header_->table_offset = kTableOffset;
+        header_->table_bytes = table_->SizeInBytes();
+        header_->sequence.store(0, std::memory_order_relaxed);
+        header_->num_items = 0;
+        header_->victim_index = 0;
+        header_->victim_tag = 0;
+        header_->victim_used = 0;
+        // the magic goes last, a reader attaching early sees no filter
+        header_->magic.store(SharedFilterHeader::kMagic, std::memory_order_release);
+        return Ok;
+    }//Create
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    Status
+    SharedCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Attach() {
+        if (region_bytes_ < kTableOffset) {
+            return NotSupported;
+        }
+        SharedFilterHeader* header = (SharedFilterHeader*) region_;
+        if (header->magic.load(std::memory_order_acquire) != SharedFilterHeader::kMagic) {
+            return NotSupported;
+        }
+        if (header->layout_version != SharedFilterHeader::kLayoutVersion ||
+            header->bits_per_item != bits_per_item ||
+            header->num_candidate_buckets != num_candidate_buckets ||
+            header->table_offset != kTableOffset ||
+            region_bytes_ < RequiredBytes(header->max_num_keys)) {
+            return NotSupported;
+        }
+        SingleTable<bits_per_item>* table =
+            new SingleTable<bits_per_item>(num_candidate_buckets, header->max_num_keys, region_ + kTableOffset);
+        if (table->SizeInBuckets() != header->num_buckets ||
+            table->BlockSize() != header->block_size) {
+            // written by a build that sizes tables differently
+            delete table;
+            return NotSupported;
+        }
+        delete table_;
+        table_ = table;
+        header_ = header;
+        geometry_ = table_->Geometry();
+        return Ok;
+    }//Attach
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    template <typename Read>
+    bool
+    SharedCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::ReadConsistent(Read&& read) const {
+        uint64_t stuck_on = 0;
+        size_t stuck = 0;
+        while (true) {
+            const uint64_t before = header_->sequence.load(std::memory_order_acquire);
+            if (!(before & 1)) {
+                read();
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (header_->sequence.load(std::memory_order_relaxed) == before) {
+                    return true;
+                }
+                continue;
+            }
+            // only a write that does not end counts, a busy writer moves on
+            stuck = before == stuck_on ? stuck + 1 : 0;
+            stuck_on = before;
+            if (stuck >= kSharedReadRetries) {
+                return false;
+            }
+            // most writes are a few kicks, wait for those on the core; a writer
+            // that was descheduled needs the core back
+            if (stuck < kSharedReadSpins) {
+                _mm_pause();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }//ReadConsistent
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    bool
+    SharedCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Place(const size_t i, const uint32_t tag) {
+        TagSlots<SingleTable<bits_per_item> > slots(table_);
+        size_t victim_index;
+        uint32_t victim_tag;
+        if (Walk::Place(geometry_, slots, i, tag, &seed_, &victim_index, &victim_tag)) {
+            return true;
+        }
+        header_->victim_index = victim_index;
+        header_->victim_tag = victim_tag;
+        header_->victim_used = 1;
+        return false;
+    }//Place
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    Status
+    SharedCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Add(const ItemType& item) {
+        if (header_->victim_used) {
+            return NotEnoughSpace;
+        }
+        size_t i;
+        uint32_t tag;
+        SplitHash(Filter::Hash(item), &i, &tag);
+        BeginWrite();
+        if (Place(i, tag)) {
+            header_->num_items++;
+        }
+        EndWrite();
+        return Ok;
+    }//Add
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    Status
+    SharedCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Delete(const ItemType& item) {
+        size_t i;
+        uint32_t tag;
+        SplitHash(Filter::Hash(item), &i, &tag);
+        size_t index[num_candidate_buckets];
+        Candidates(i, tag, index);
+
+        Status status = NotFound;
+        BeginWrite();
+        for (size_t j = 0; j < num_candidate_buckets; j++) {
+            if (!table_->DeleteTagFromBucket(index[j], tag)) continue;
+            header_->num_items--;
+            status = Ok;
+            if (header_->victim_used) {
+                header_->victim_used = 0;
+                if (Place(header_->victim_index, header_->victim_tag)) {
+                    header_->num_items++;
+                }
+            }
+            break;
+        }
+        if (status == NotFound && VictimMatch(tag, index)) {
+            header_->victim_used = 0;
+            status = Ok;
+        }
+        EndWrite();
+        return status;
+    }//Delete
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    bool
+    SharedCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::ContainImpl(const size_t i,
+                                                                                   const uint32_t tag) const {
+        size_t index[num_candidate_buckets];
+        Candidates(i, tag, index);
+        for (size_t j = 0; j < num_candidate_buckets; j++) {
+            if (table_->FindTagInBucket(index[j], tag)) return true;
+        }
+        return VictimMatch(tag, index);
+    }//ContainImpl
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    Status
+    SharedCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Contain(const ItemType& item) const {
+        size_t i;
+        uint32_t tag;
+        SplitHash(Filter::Hash(item), &i, &tag);
+        bool found = false;
+        if (!ReadConsistent([&]() { found = ContainImpl(i, tag); })) {
+            return IOError;
+        }
+        return found ? Ok : NotFound;
+    }//Contain
+
+    template <typename ItemType, size_t bits_per_item, size_t num_candidate_buckets>
+    size_t
+    SharedCuckooFilter<ItemType, bits_per_item, num_candidate_buckets>::Size() const {
+        size_t size = 0;
+        if (!ReadConsistent([&]() { size = header_->num_items; })) {
+            return header_->num_items;
+        }
+        return size;
+    }//Size
+}  // namespace d_ary_cuckoofilter
+
+#endif // #ifndef _SHARED_CUCKOO_FILTER_H_
@@ -7,16 +7,29 @@
 #include <assert.h>
 
 #include "bitsutil.h"
+#include "dirtypages.h"
 #include "debug.h"
 
 
 namespace d_ary_cuckoofilter {
     
+    // the word a tag of SingleTable is stored in, only defined for the
+    // supported tag sizes
+    template <size_t bits_per_tag> struct TagWord;
+    template <> struct TagWord<8>  { typedef uint8_t  type; };
+    template <> struct TagWord<16> { typedef uint16_t type; };
+    template <> struct TagWord<32> { typedef uint32_t type; };
+    
     // the most naive table implementation: one huge bit array
     template <size_t bits_per_tag> //8,16,32
     class SingleTable {
         
-        static const size_t bytes_per_bucket = (bits_per_tag + 7) >> 3;
+        static_assert(bits_per_tag == 8 || bits_per_tag == 16 || bits_per_tag == 32,
+                      "SingleTable supports 8, 16 and 32-bit tags");
+        
+        typedef typename TagWord<bits_per_tag>::type Word;
+        
+        static const size_t bytes_per_bucket = sizeof(Word);
         
         struct Bucket {
             unsigned char bits_[bytes_per_bucket];
@@ -24,47 +37,67 @@ namespace d_ary_cuckoofilter {
         
         size_t num_buckets;
         
+        // AltIndex stays inside the blocks of the geometry
+        TableGeometry geometry_;
+        
         // using a pointer adds one more indirection
         Bucket *buckets_;
         
+        // pages written since the last delta, NULL unless tracking is enabled
+        DirtyPages *dirty_;
+        
+        // false if buckets_ lives in memory provided by the caller
+        bool owns_buckets_;
+        
     public:
         static const uint32_t TAGMASK = (1ULL << bits_per_tag) - 1; //mask
         
+        static double LoadThreshold(size_t num_candidate_buckets) {
+            return loadthreshold(num_candidate_buckets);
+        }
+        
+        // layout of the table holding max_num_keys items
+        static TableGeometry Geometry(size_t num_candidate_buckets, size_t max_num_keys) {
+            if (num_candidate_buckets < 2 || num_candidate_buckets > 8) {
+                return TableGeometry();
+            }
+            return TableGeometry::Exact(max_num_keys, num_candidate_buckets,
+                                        LoadThreshold(num_candidate_buckets));
+        }
+        
+        // number of buckets allocated for max_num_keys items
+        static size_t NumBuckets(size_t num_candidate_buckets, size_t max_num_keys) {
+            return Geometry(num_candidate_buckets, max_num_keys).num_buckets;
+        }
+        
+        // bytes of the table holding max_num_keys items
+        static size_t NumBytes(size_t num_candidate_buckets, size_t max_num_keys) {
+            return NumBuckets(num_candidate_buckets, max_num_keys) * bytes_per_bucket;
+        }
+        
         explicit
         SingleTable(size_t num_candidate_buckets, size_t max_num_keys) {
-            switch (num_candidate_buckets) {
-                case 2:
-                    num_buckets = upperpower2(max_num_keys);
-                    break;
-                case 3:
-                    num_buckets = upperpower3(max_num_keys);
-                    break;
-                case 4:
-                    num_buckets = upperpower4(max_num_keys);
-                    break;
-                case 5:
-                    num_buckets = upperpower5(max_num_keys);
-                    break;
-                default:
-                    break;
-            }
-            double frac = (double) max_num_keys / num_buckets;
-            switch (num_candidate_buckets) {
-                case 2:
-                    if (frac > 0.42) num_buckets <<= 1; break;
-                case 3:
-                    if (frac > 0.91) num_buckets *= 3;  break;
-                case 4:
-                    if (frac > 0.97) num_buckets *= 4;  break;
-                case 5:
-                    if (frac > 0.985) num_buckets *= 5; break;
-            }
+            geometry_ = Geometry(num_candidate_buckets, max_num_keys);
+            num_buckets = geometry_.num_buckets;
             buckets_ = new Bucket[num_buckets];
+            dirty_ = NULL;
+            owns_buckets_ = true;
             CleanupTags();
         }
         
+        // a table over NumBytes() bytes at memory, e.g. shared memory, which is
+        // neither cleared nor freed
+        SingleTable(size_t num_candidate_buckets, size_t max_num_keys, void* memory) {
+            geometry_ = Geometry(num_candidate_buckets, max_num_keys);
+            num_buckets = geometry_.num_buckets;
+            buckets_ = (Bucket*) memory;
+            dirty_ = NULL;
+            owns_buckets_ = false;
+        }
+        
         ~SingleTable() {
-            delete [] buckets_;
+            if (owns_buckets_) delete [] buckets_;
+            delete dirty_;
         }
         
         void CleanupTags() { memset(buckets_, 0, bytes_per_bucket * num_buckets); }
@@ -73,53 +106,64 @@ namespace d_ary_cuckoofilter {
         
         size_t SizeInBuckets() const { return num_buckets; }
         
+        // the table as raw bytes, for snapshots and deltas
+        char* RawBytes() { return (char*) buckets_; }
+        
+        const char* RawBytes() const { return (const char*) buckets_; }
+        
+        // start recording written pages, all pages clean
+        void EnableDirtyTracking() {
+            if (!dirty_) dirty_ = new DirtyPages(SizeInBytes());
+        }
+        
+        DirtyPages* Dirty() { return dirty_; }
+        
         size_t HashTableSize() const { return num_buckets; }
         
+        size_t BlockSize() const { return geometry_.block_size; }
+        
+        const TableGeometry& Geometry() const { return geometry_; }
+        
         std::string Info() const  {
             std::stringstream ss;
             ss << "\t\tSingleHashtable with tag size: " << bits_per_tag << " bits \n";
             ss << "\t\tTotal rows: " << num_buckets << "\n";
+            ss << "\t\tBlock size: " << geometry_.block_size << "\n";
             ss << "\t\tTable size in bits: " << SizeInBuckets() * bits_per_tag << "\n";
             return ss.str();
         }
         
         
         inline uint32_t ReadTag(const size_t i) const {
-            const unsigned char *p = buckets_[i].bits_;
-            uint32_t tag;
             /* following code only works for little-endian */
-            if (bits_per_tag == 8) {
-                tag = *((uint8_t*) p);
-            }
-            else if (bits_per_tag == 16) {
-                tag = *((uint16_t*) p);
-            }
-            else if (bits_per_tag == 32) {
-                tag = *((uint32_t*) p);
-            }
-            return tag & TAGMASK;
+            Word tag;
+            memcpy(&tag, buckets_[i].bits_, sizeof(tag));
+            return tag;
         }
         
         
+        // tags of this table are always stored under their own slot
+        inline uint32_t ReadMark(const size_t) const {
+            return 0;
+        }
+        
         inline void  WriteTag(const size_t i, const uint32_t t) {
-            unsigned char *p = buckets_[i].bits_;
-            uint32_t tag = t & TAGMASK;
             /* following code only works for little-endian */
-            if (bits_per_tag == 8) {
-                ((uint8_t*) p)[0] =  tag;
-                //printFingerprint(((uint8_t*) p)[0], tag);
-                
-            }
-            else if (bits_per_tag == 16) {
-                ((uint16_t*) p)[0] = tag;
-            }
-            else if (bits_per_tag == 32) {
-                ((uint32_t*) p)[0] = tag;
-            }
-            
+            Word tag = t & TAGMASK;
+            memcpy(buckets_[i].bits_, &tag, sizeof(tag));
+            if (dirty_) dirty_->Mark(i * bytes_per_bucket);
             return;
         }
         
+        inline void PrefetchBucket(const size_t i) const {
+            _mm_prefetch((const char*) &buckets_[i], _MM_HINT_T0);
+        }
+        
+        // index the tag stored in slot i was placed under
+        inline size_t IndexOfSlot(const size_t i) const {
+            return i;
+        }
+        
         inline bool  FindTagInBucket(const size_t i,  const uint32_t tag) const {
             // caution: unaligned access & assuming little endian
             if (ReadTag(i) == tag)
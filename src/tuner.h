@@ -0,0 +1,192 @@
+// Tuner picks num_candidate_buckets, bits_per_item and TableType of a DaryCuckooFilter
+// for an expected number of keys and a target false positive rate.
+// Every configuration is measured with a quick sampled build filled to the load the
+// full-size table would reach, and the best feasible one is reported.
+#ifndef _TUNER_H_
+#define _TUNER_H_
+
+#include "d_ary_cuckoofilter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace d_ary_cuckoofilter {
+
+    struct TunerOptions {
+        // number of keys the filter will hold
+        size_t expected_keys;
+        // largest acceptable false positive rate
+        double target_fpr;
+        // memory budget of the table in bytes, 0 for no cap
+        size_t memory_cap_bytes;
+        // budget of a Contain in nanoseconds, 0 for no goal
+        double latency_goal_ns;
+        // number of keys inserted by each sampled build
+        size_t sample_keys;
+
+        TunerOptions(): expected_keys(0), target_fpr(0.01), memory_cap_bytes(0),
+                        latency_goal_ns(0), sample_keys(1 << 16) {}
+    };
+
+    struct TunedConfig {
+        size_t num_candidate_buckets;
+        size_t bits_per_item;
+        std::string table;
+
+        // measured on the sampled build
+        double add_ns;
+        double contain_ns;
+        double load_factor;
+        double measured_fpr;
+        bool sample_ok;
+
+        // predicted for expected_keys
+        double expected_fpr;
+        size_t size_in_bytes;
+        double bits_per_key;
+
+        bool feasible;
+
+        // type of the filter to instantiate
+        std::string TypeName() const {
+            std::stringstream ss;
+            ss << "DaryCuckooFilter<ItemType, " << bits_per_item << ", "
+               << num_candidate_buckets << ", " << table << ">";
+            return ss.str();
+        }
+
+        std::string Info() const {
+            std::stringstream ss;
+            ss << TypeName() << "\n"
+               << "\t\tAdd: " << add_ns << " ns/op\n"
+               << "\t\tContain: " << contain_ns << " ns/op\n"
+               << "\t\tAchieved load: " << load_factor << "\n"
+               << "\t\tBits per key: " << bits_per_key << "\n"
+               << "\t\tTable size in bytes: " << size_in_bytes << "\n"
+               << "\t\tExpected fpr: " << expected_fpr << "\n"
+               << "\t\tMeasured fpr: " << measured_fpr << "\n";
+            return ss.str();
+        }
+    };
+
+    class Tuner {
+        typedef std::chrono::steady_clock Clock;
+
+        static double NsPerOp(Clock::time_point start, size_t ops) {
+            if (ops == 0) return 0;
+            return 1.0 * std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - start).count() / ops;
+        }
+
+        template <size_t bits_per_item, size_t num_candidate_buckets,
+        template<size_t> class TableType>
+        static TunedConfig Measure(const TunerOptions& opts, const char* table) {
+            typedef TableType<bits_per_item> Table;
+            TunedConfig c;
+            c.num_candidate_buckets = num_candidate_buckets;
+            c.bits_per_item = bits_per_item;
+            c.table = table;
+
+            // fill the sample to the load the full-size table would reach
+            size_t full_buckets = Table::NumBuckets(num_candidate_buckets, opts.expected_keys);
+            double full_load = 1.0 * opts.expected_keys / full_buckets;
+            size_t sample_keys = std::min(opts.expected_keys, opts.sample_keys);
+            DaryCuckooFilter<uint64_t, bits_per_item, num_candidate_buckets, TableType>
+                filter(sample_keys);
+            size_t sample_buckets = Table::NumBuckets(num_candidate_buckets, sample_keys);
+            size_t num_keys = full_load * sample_buckets;
+
+            Clock::time_point start = Clock::now();
+            size_t num_inserted = 0;
+            for (; num_inserted < num_keys; num_inserted++) {
+                if (filter.Add(num_inserted) != Ok) break;
+            }
+            c.add_ns = NsPerOp(start, num_inserted);
+            // a key left in the victim slot means the sample did not fit
+            c.sample_ok = (num_inserted == num_keys) && (filter.Size() == num_keys);
+            c.load_factor = filter.LoadFactor();
+
+            // half positive, half negative queries
+            size_t false_queries = 0;
+            start = Clock::now();
+            for (size_t i = 0; i < num_inserted; i++) {
+                filter.Contain(i);
+                if (filter.Contain(num_keys + i) == Ok) false_queries++;
+            }
+            c.contain_ns = NsPerOp(start, 2 * num_inserted);
+            c.measured_fpr = num_inserted ? 1.0 * false_queries / num_inserted : 0;
+
+            // a negative query matches any of the d candidates holding the same
+            // nonzero tag
+            c.expected_fpr = num_candidate_buckets * full_load / ((1ULL << bits_per_item) - 1);
+            // bytes per bucket are fractional for packed slots, so scale the
+            // sample before dividing
+            c.size_in_bytes = (size_t) ceil(1.0 * filter.SizeInBytes() * full_buckets /
+                                            filter.SizeInBuckets());
+            c.bits_per_key = 8.0 * c.size_in_bytes / opts.expected_keys;
+
+            c.feasible = c.sample_ok && c.expected_fpr <= opts.target_fpr;
+            if (opts.memory_cap_bytes) {
+                c.feasible = c.feasible && c.size_in_bytes <= opts.memory_cap_bytes;
+            }
+            if (opts.latency_goal_ns > 0) {
+                c.feasible = c.feasible && c.contain_ns <= opts.latency_goal_ns;
+            }
+            return c;
+        }
+
+        template <size_t bits_per_item, template<size_t> class TableType>
+        static void MeasureAll(const TunerOptions& opts, const char* table,
+                               std::vector<TunedConfig>* out) {
+            out->push_back(Measure<bits_per_item, 2, TableType>(opts, table));
+            out->push_back(Measure<bits_per_item, 3, TableType>(opts, table));
+            out->push_back(Measure<bits_per_item, 4, TableType>(opts, table));
+            out->push_back(Measure<bits_per_item, 5, TableType>(opts, table));
+            out->push_back(Measure<bits_per_item, 6, TableType>(opts, table));
+            out->push_back(Measure<bits_per_item, 7, TableType>(opts, table));
+            out->push_back(Measure<bits_per_item, 8, TableType>(opts, table));
+        }
+
+        // with a latency goal the smallest table wins, otherwise the fastest one
+        static bool Better(const TunerOptions& opts, const TunedConfig& a, const TunedConfig& b) {
+            if (a.feasible != b.feasible) return a.feasible;
+            if (!a.feasible) return a.expected_fpr < b.expected_fpr;
+            if (opts.latency_goal_ns > 0) return a.size_in_bytes < b.size_in_bytes;
+            return a.contain_ns < b.contain_ns;
+        }
+
+    public:
+        // measure every supported configuration
+        static std::vector<TunedConfig> Evaluate(const TunerOptions& opts) {
+            std::vector<TunedConfig> configs;
+            MeasureAll<8, SingleTable>(opts, "SingleTable", &configs);
+            MeasureAll<16, SingleTable>(opts, "SingleTable", &configs);
+            MeasureAll<32, SingleTable>(opts, "SingleTable", &configs);
+            MeasureAll<8, PackedTable>(opts, "PackedTable", &configs);
+            MeasureAll<16, PackedTable>(opts, "PackedTable", &configs);
+            MeasureAll<8, CompactPackedTable>(opts, "CompactPackedTable", &configs);
+            MeasureAll<16, CompactPackedTable>(opts, "CompactPackedTable", &configs);
+            return configs;
+        }
+
+        // best of the measured configurations; feasible is false if none meets
+        // the options
+        static TunedConfig Pick(const TunerOptions& opts, const std::vector<TunedConfig>& configs) {
+            size_t best = 0;
+            for (size_t i = 1; i < configs.size(); i++) {
+                if (Better(opts, configs[i], configs[best])) best = i;
+            }
+            return configs[best];
+        }
+        
+        static TunedConfig Tune(const TunerOptions& opts) {
+            return Pick(opts, Evaluate(opts));
+        }
+    };
+}  // namespace d_ary_cuckoofilter
+
+#endif // #ifndef _TUNER_H_
@@ -0,0 +1,121 @@
+// ValueTable is the hashtable of d-ary Cuckoo map: one slot per bucket holding a
+// tag and a small value next to it
+#ifndef _VALUE_TABLE_H_
+#define _VALUE_TABLE_H_
+
+#include <sstream>
+#include <string.h>
+#include <xmmintrin.h>
+#include <assert.h>
+
+#include "bitsutil.h"
+#include "debug.h"
+
+
+namespace d_ary_cuckoofilter {
+
+    // the smallest word holding num_bits bits
+    template <size_t num_bits, typename Enable = void> struct SlotWord;
+    template <size_t num_bits> struct SlotWord<num_bits, typename std::enable_if<(num_bits <= 8)>::type> {
+        typedef uint8_t type;
+    };
+    template <size_t num_bits> struct SlotWord<num_bits, typename std::enable_if<(num_bits > 8 && num_bits <= 16)>::type> {
+        typedef uint16_t type;
+    };
+    template <size_t num_bits> struct SlotWord<num_bits, typename std::enable_if<(num_bits > 16 && num_bits <= 32)>::type> {
+        typedef uint32_t type;
+    };
+    template <size_t num_bits> struct SlotWord<num_bits, typename std::enable_if<(num_bits > 32 && num_bits <= 64)>::type> {
+        typedef uint64_t type;
+    };
+
+    // a slot is the tag in the low bits and the value above it, in the smallest
+    // word holding both, e.g. 16 bits for an 8-bit tag and an 8-bit value
+    template <size_t bits_per_tag, size_t bits_per_value>
+    class ValueTable {
+
+        static_assert(bits_per_tag >= 1 && bits_per_tag <= 32,
+                      "ValueTable stores tags of 1 to 32 bits");
+        static_assert(bits_per_value >= 1 && bits_per_value <= 32,
+                      "ValueTable stores values of 1 to 32 bits");
+
+        typedef typename SlotWord<bits_per_tag + bits_per_value>::type Word;
+
+        static const size_t bytes_per_bucket = sizeof(Word);
+
+        size_t num_buckets;
+
+        // AltIndex stays inside the blocks of the geometry
+        TableGeometry geometry_;
+
+        Word *buckets_;
+
+    public:
+        static const uint32_t TAGMASK = (1ULL << bits_per_tag) - 1;
+        static const uint32_t VALUEMASK = (1ULL << bits_per_value) - 1;
+
+        static double LoadThreshold(size_t num_candidate_buckets) {
+            return loadthreshold(num_candidate_buckets);
+        }
+
+        // layout of the table holding max_num_keys items
+        static TableGeometry Geometry(size_t num_candidate_buckets, size_t max_num_keys) {
+            if (num_candidate_buckets < 2 || num_candidate_buckets > 8) {
+                return TableGeometry();
+            }
+            return TableGeometry::Exact(max_num_keys, num_candidate_buckets,
+                                        LoadThreshold(num_candidate_buckets));
+        }
+
+        explicit
+        ValueTable(size_t num_candidate_buckets, size_t max_num_keys) {
+            geometry_ = Geometry(num_candidate_buckets, max_num_keys);
+            num_buckets = geometry_.num_buckets;
+            buckets_ = new Word[num_buckets];
+            CleanupTags();
+        }
+
+        ~ValueTable() {
+            delete [] buckets_;
+        }
+
+        void CleanupTags() { memset(buckets_, 0, bytes_per_bucket * num_buckets); }
+
+        size_t SizeInBytes() const { return bytes_per_bucket * num_buckets; }
+
+        size_t SizeInBuckets() const { return num_buckets; }
+
+        size_t HashTableSize() const { return num_buckets; }
+
+        const TableGeometry& Geometry() const { return geometry_; }
+
+        std::string Info() const  {
+            std::stringstream ss;
+            ss << "\t\tValueHashtable with tag size: " << bits_per_tag << " bits \n";
+            ss << "\t\tValueHashtable with value size: " << bits_per_value << " bits \n";
+            ss << "\t\tTotal rows: " << num_buckets << "\n";
+            ss << "\t\tBlock size: " << geometry_.block_size << "\n";
+            ss << "\t\tTable size in bits: " << SizeInBytes() * 8 << "\n";
+            return ss.str();
+        }
+
+        inline uint32_t ReadTag(const size_t i) const {
+            return buckets_[i] & TAGMASK;
+        }
+
+        inline uint32_t ReadValue(const size_t i) const {
+            return (buckets_[i] >> bits_per_tag) & VALUEMASK;
+        }
+
+        inline void WriteSlot(const size_t i, const uint32_t tag, const uint32_t value) {
+            buckets_[i] = (Word) ((tag & TAGMASK) | ((uint64_t) (value & VALUEMASK) << bits_per_tag));
+        }
+
+        inline void PrefetchBucket(const size_t i) const {
+            _mm_prefetch((const char*) &buckets_[i], _MM_HINT_T0);
+        }
+
+    };// ValueTable
+}
+
+#endif // #ifndef _VALUE_TABLE_H_